@@ -0,0 +1,132 @@
+#include "arena.h"
+
+#include <atomic>
+#include <new>
+
+static thread_local NodeArena* current_arena = nullptr;
+
+static std::atomic<size_t> heap_allocations{ 0 };
+
+NodeArena::Scope::Scope(NodeArena& arena) :
+	_previous{ current_arena }
+{
+	current_arena = &arena;
+}
+NodeArena::Scope::~Scope() { current_arena = _previous; }
+
+
+
+
+NodeArena::Pool::Pool() :
+	blocks{},
+	blockUsed{ BLOCK_SIZE },
+	free{},
+	allocations{ 0 },
+	bytes{ 0 },
+	live{ 0 },
+	orphaned{ false }
+{}
+
+void* NodeArena::Pool::allocate(size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	allocations++;
+	live++;
+
+	const size_t sizeClass = size / ALIGNMENT;
+	if (sizeClass < free.size() && free[sizeClass])
+	{
+		void* ptr = free[sizeClass];
+		free[sizeClass] = *static_cast<void**>(ptr);
+		return ptr;
+	}
+
+	bytes += size;
+	if (size > BLOCK_SIZE / 4)
+	{
+		/* Big requests get their own block, kept before the one being filled */
+		std::unique_ptr<char[]> block{ new char[size] };
+		char* ptr = block.get();
+		blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, std::move(block));
+		return ptr;
+	}
+
+	if (blockUsed + size > BLOCK_SIZE)
+	{
+		blocks.emplace_back(new char[BLOCK_SIZE]);
+		blockUsed = 0;
+	}
+
+	char* ptr = blocks.back().get() + blockUsed;
+	blockUsed += size;
+	return ptr;
+}
+
+void NodeArena::Pool::release(void* ptr, size_t size)
+{
+	const size_t sizeClass = ((size + ALIGNMENT - 1) & ~(ALIGNMENT - 1)) / ALIGNMENT;
+	if (sizeClass >= free.size())
+		free.resize(sizeClass + 1, nullptr);
+
+	*static_cast<void**>(ptr) = free[sizeClass];
+	free[sizeClass] = ptr;
+	live--;
+}
+
+
+
+
+NodeArena::NodeArena() :
+	_pool{ new Pool{} }
+{}
+NodeArena::~NodeArena()
+{
+	if (_pool->live == 0)
+		delete _pool;
+	else _pool->orphaned = true;
+}
+
+void* NodeArena::allocate(size_t size) { return _pool->allocate(size); }
+void NodeArena::release(void* ptr, size_t size) { _pool->release(ptr, size); }
+
+size_t NodeArena::allocations() const { return _pool->allocations; }
+size_t NodeArena::blocks() const { return _pool->blocks.size(); }
+size_t NodeArena::bytes() const { return _pool->bytes; }
+size_t NodeArena::live() const { return _pool->live; }
+
+NodeArena* NodeArena::current() { return current_arena; }
+
+void* NodeArena::allocateNode(size_t size)
+{
+	Pool* pool = current_arena ? current_arena->_pool : nullptr;
+	char* raw;
+	if (pool)
+		raw = static_cast<char*>(pool->allocate(HEADER_SIZE + size));
+	else
+	{
+		raw = static_cast<char*>(::operator new(HEADER_SIZE + size));
+		heap_allocations++;
+	}
+
+	*reinterpret_cast<Pool**>(raw) = pool;
+	return raw + HEADER_SIZE;
+}
+
+void NodeArena::releaseNode(void* node, size_t size)
+{
+	if (!node)
+		return;
+
+	char* raw = static_cast<char*>(node) - HEADER_SIZE;
+	Pool* pool = *reinterpret_cast<Pool**>(raw);
+	if (!pool)
+		::operator delete(raw);
+	else
+	{
+		pool->release(raw, HEADER_SIZE + size);
+		if (pool->orphaned && pool->live == 0)
+			delete pool;
+	}
+}
+
+size_t NodeArena::heapAllocations() { return heap_allocations; }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+/*
+ * Bump allocator for the nodes of one compilation. Released nodes are recycled by size, and blocks are given back
+ * when the arena dies. Nodes still own memory of their own, so they cannot be dropped with the blocks: a node that
+ * outlives its arena keeps the blocks alive, and the release of the last such node gives them back.
+ */
+class NodeArena
+{
+public:
+	/* Makes an arena the current one of the calling thread while alive */
+	class Scope
+	{
+	private:
+		NodeArena* _previous;
+
+	public:
+		Scope(NodeArena& arena);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+	};
+
+private:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+	static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+	/* Storage of an arena, owned by the arena or, once it died, by the nodes still allocated from it */
+	struct Pool
+	{
+		std::vector<std::unique_ptr<char[]>> blocks;
+		size_t blockUsed;
+
+		/* Intrusive free lists indexed by size in ALIGNMENT units */
+		std::vector<void*> free;
+
+		size_t allocations;
+		size_t bytes;
+		size_t live;
+
+		/* The arena died and the last released node deletes the pool */
+		bool orphaned;
+
+		Pool();
+
+		void* allocate(size_t size);
+		void release(void* ptr, size_t size);
+	};
+
+	/* Every node is preceded by the pool it came from, or nullptr if it came from the heap */
+	static constexpr size_t HEADER_SIZE = (sizeof(Pool*) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	Pool* _pool;
+
+public:
+	NodeArena();
+	~NodeArena();
+
+	NodeArena(const NodeArena&) = delete;
+	NodeArena(NodeArena&&) = delete;
+
+	NodeArena& operator= (const NodeArena&) = delete;
+	NodeArena& operator= (NodeArena&&) = delete;
+
+	void* allocate(size_t size);
+	void release(void* ptr, size_t size);
+
+	size_t allocations() const;
+	size_t blocks() const;
+	size_t bytes() const;
+
+	/* Nodes allocated and not released yet */
+	size_t live() const;
+
+public:
+	/* Arena of the running compilation, or nullptr if nodes go to the heap */
+	static NodeArena* current();
+
+	/* Backing of the class-level operator new and delete of nodes */
+	static void* allocateNode(size_t size);
+	static void releaseNode(void* node, size_t size);
+
+	/* Nodes taken from the heap so far by allocateNode, on every thread */
+	static size_t heapAllocations();
+};
@@ -0,0 +1,267 @@
+#include "ast.h"
+
+namespace ast
+{
+	const Operator& Node::getOperator() const
+	{
+		if (!isOperation())
+			throw IllegalState{ "Leaf nodes have no operator" };
+		return Operator::get(oper);
+	}
+
+	size_t Node::childCount() const
+	{
+		switch (kind)
+		{
+			case NodeKind::Unary: return 1;
+			case NodeKind::Binary:
+			case NodeKind::Assignment: return 2;
+			case NodeKind::Ternary: return 3;
+			default: return 0;
+		}
+	}
+
+
+
+	Tree::Tree() :
+		_nodes{},
+		_symbols{ &SymbolTable::current() }
+	{}
+	Tree::Tree(SymbolTable& symbols) :
+		_nodes{},
+		_symbols{ &symbols }
+	{}
+	Tree::~Tree() {}
+
+	size_t Tree::size() const { return _nodes.size(); }
+	bool Tree::empty() const { return _nodes.empty(); }
+	void Tree::reserve(size_t count) { _nodes.reserve(count); }
+	void Tree::clear() { _nodes.clear(); }
+
+	const SymbolTable& Tree::symbols() const { return *_symbols; }
+
+	const Node& Tree::get(NodeRef ref) const
+	{
+		if (ref >= _nodes.size())
+			throw BadIndex{ ref, 0, _nodes.size() };
+		return _nodes[ref];
+	}
+
+	NodeRef Tree::push(const Node& node)
+	{
+		if (_nodes.size() >= NO_NODE)
+			throw IllegalState{ "Too many ast nodes" };
+		_nodes.push_back(node);
+		return static_cast<NodeRef>(_nodes.size() - 1);
+	}
+
+	NodeRef Tree::operation(NodeKind kind, const Operator& op, NodeRef c0, NodeRef c1, NodeRef c2, NodeId source)
+	{
+		const NodeRef count = static_cast<NodeRef>(_nodes.size());
+		for (NodeRef child : { c0, c1, c2 })
+			if (child != NO_NODE && child >= count)
+				throw BadIndex{ child, 0, count };
+
+		return push({ kind, op.getId(), source, 0, { c0, c1, c2 } });
+	}
+
+	NodeRef Tree::identifier(Symbol symbol, NodeId source)
+	{
+		return push({ NodeKind::Identifier, Operator::Id{}, source, symbol, { NO_NODE, NO_NODE, NO_NODE } });
+	}
+	NodeRef Tree::integer(FieldValue value, NodeId source)
+	{
+		return push({ NodeKind::Integer, Operator::Id{}, source, static_cast<uint32_t>(value), { NO_NODE, NO_NODE, NO_NODE } });
+	}
+	NodeRef Tree::constant(CodeValue value, NodeId source)
+	{
+		return push({ NodeKind::Constant, Operator::Id{}, source, value, { NO_NODE, NO_NODE, NO_NODE } });
+	}
+	NodeRef Tree::unary(const Operator& op, NodeRef operand, NodeId source)
+	{
+		if (!op.isUnary())
+			throw InvalidParameter{ "op", "Required a Unary operator" };
+		return operation(NodeKind::Unary, op, operand, NO_NODE, NO_NODE, source);
+	}
+	NodeRef Tree::binary(const Operator& op, NodeRef left, NodeRef right, NodeId source)
+	{
+		if (!op.isBinary())
+			throw InvalidParameter{ "op", "Required a Binary operator" };
+		return operation(NodeKind::Binary, op, left, right, NO_NODE, source);
+	}
+	NodeRef Tree::assignment(const Operator& op, NodeRef left, NodeRef right, NodeId source)
+	{
+		if (!op.isAssignment())
+			throw InvalidParameter{ "op", "Required an Assignment operator" };
+		return operation(NodeKind::Assignment, op, left, right, NO_NODE, source);
+	}
+	NodeRef Tree::ternary(NodeRef condition, NodeRef ifTrue, NodeRef ifFalse, NodeId source)
+	{
+		return operation(NodeKind::Ternary, Operator::TernaryConditional, condition, ifTrue, ifFalse, source);
+	}
+
+	NodeRef Tree::add(const Statement& statement, NodeId source, const SourceMap* sources)
+	{
+		struct Pending
+		{
+			const Statement* statement;
+			NodeId source;
+			bool expanded;
+		};
+
+		if (!sources)
+			source = INVALID_NODE;
+
+		/* Post-order walk with explicit stacks: statements come deeper than the call stack allows */
+		std::vector<Pending> work{ { &statement, source, false } };
+		std::vector<NodeRef> results;
+
+		while (!work.empty())
+		{
+			const Pending pending = work.back();
+			work.pop_back();
+
+			const Statement& current = *pending.statement;
+			const NodeId source = pending.source;
+			switch (current.getCodeFragmentType())
+			{
+				case CodeFragmentType::Identifier: {
+					const Identifier& id = static_cast<const Identifier&>(current);
+					results.push_back(identifier(_symbols->intern(id.getName()), source));
+				} break;
+
+				case CodeFragmentType::LiteralInteger:
+					results.push_back(integer(static_cast<const LiteralInteger&>(current).getValue(), source));
+					break;
+
+				case CodeFragmentType::TypeConstant:
+					results.push_back(constant(static_cast<const TypeConstant&>(current).getValue(), source));
+					break;
+
+				case CodeFragmentType::Operation: {
+					const Operation& op = static_cast<const Operation&>(current);
+					const size_t count = op.getOperandCount();
+					if (!pending.expanded)
+					{
+						work.push_back({ &current, source, true });
+						for (size_t i = count; i > 0; --i)
+						{
+							const NodeId operand = source != INVALID_NODE ? sources->operand(source, i - 1) : INVALID_NODE;
+							work.push_back({ &op.getOperand(i - 1), operand, false });
+						}
+						break;
+					}
+
+					NodeRef children[3] = { NO_NODE, NO_NODE, NO_NODE };
+					for (size_t i = count; i > 0; --i)
+					{
+						children[i - 1] = results.back();
+						results.pop_back();
+					}
+
+					const Operator& oper = op.getOperator();
+					NodeRef ref;
+					if (oper.isUnary())
+						ref = unary(oper, children[0], source);
+					else if (oper.isTernary())
+						ref = ternary(children[0], children[1], children[2], source);
+					else if (oper.isAssignment())
+						ref = assignment(oper, children[0], children[1], source);
+					else ref = binary(oper, children[0], children[1], source);
+					results.push_back(ref);
+				} break;
+
+				default:
+					throw InvalidParameter{ "statement", "Statement has no flat form" };
+			}
+		}
+
+		return results.back();
+	}
+
+
+
+	namespace
+	{
+		/* Texts of the nodes are built bottom-up in one scan; a child's text is moved into its last user */
+		class Printer : public Visitor<Printer, std::string>
+		{
+		private:
+			std::vector<std::string>& _texts;
+			std::vector<uint32_t>& _uses;
+
+			std::string take(NodeRef child)
+			{
+				if (--_uses[child] == 0)
+					return std::move(_texts[child]);
+				return _texts[child];
+			}
+
+		public:
+			Printer(std::vector<std::string>& texts, std::vector<uint32_t>& uses) : _texts{ texts }, _uses{ uses } {}
+
+			std::string visitIdentifier(const Tree& tree, NodeRef, const Node& node)
+			{
+				return std::string{ tree.symbols().name(node.symbol()) };
+			}
+			std::string visitInteger(const Tree&, NodeRef, const Node& node)
+			{
+				return std::to_string(node.integer());
+			}
+			std::string visitConstant(const Tree&, NodeRef, const Node& node)
+			{
+				return TypeConstant{ node.constant() }.toString();
+			}
+			std::string visitUnary(const Tree&, NodeRef, const Node& node)
+			{
+				const Operator& op = node.getOperator();
+				return node.oper == Operator::Id::SufixIncrement || node.oper == Operator::Id::SufixDecrement
+					? take(node.children[0]) + op.toString()
+					: op.toString() + take(node.children[0]);
+			}
+			std::string visitBinary(const Tree&, NodeRef, const Node& node)
+			{
+				std::string text = take(node.children[0]);
+				text += " " + node.getOperator().toString() + " ";
+				return text += take(node.children[1]);
+			}
+			std::string visitAssignment(const Tree& tree, NodeRef ref, const Node& node)
+			{
+				return visitBinary(tree, ref, node);
+			}
+			std::string visitTernary(const Tree&, NodeRef, const Node& node)
+			{
+				std::string text = take(node.children[0]);
+				text += " ? ";
+				text += take(node.children[1]);
+				text += " : ";
+				return text += take(node.children[2]);
+			}
+		};
+	}
+
+	std::string Tree::toString(NodeRef root) const
+	{
+		get(root);
+
+		/* Children have lower ids than their parents, so one descending pass finds every node under root */
+		std::vector<uint32_t> uses(static_cast<size_t>(root) + 1, 0);
+		uses[root] = 1;
+		for (NodeRef ref = root + 1; ref-- > 0;)
+		{
+			if (uses[ref] == 0)
+				continue;
+			const Node& node = _nodes[ref];
+			for (size_t i = 0; i < node.childCount(); ++i)
+				uses[node.children[i]]++;
+		}
+
+		std::vector<std::string> texts(static_cast<size_t>(root) + 1);
+		Printer printer{ texts, uses };
+		for (NodeRef ref = 0; ref <= root; ++ref)
+			if (uses[ref] > 0)
+				texts[ref] = printer.visit(*this, ref);
+
+		return std::move(texts[root]);
+	}
+}
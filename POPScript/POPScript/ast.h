@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "parser_elements.h"
+#include "spans.h"
+
+/* Flat form of statements: tagged nodes in one array, linked by 32-bit ids, traversed without virtual calls */
+namespace ast
+{
+	typedef uint32_t NodeRef;
+
+	constexpr NodeRef NO_NODE = UINT32_MAX;
+
+	enum class NodeKind : uint8_t
+	{
+		Identifier,
+		Integer,
+		Constant,
+		Unary,
+		Binary,
+		Assignment,
+		Ternary
+	};
+
+	struct Node
+	{
+		NodeKind kind;
+		Operator::Id oper;
+		NodeId source;
+		uint32_t value;
+		NodeRef children[3];
+
+		inline bool isLeaf() const { return kind < NodeKind::Unary; }
+		inline bool isOperation() const { return kind >= NodeKind::Unary; }
+
+		inline Symbol symbol() const { return static_cast<Symbol>(value); }
+		inline FieldValue integer() const { return static_cast<FieldValue>(value); }
+		inline CodeValue constant() const { return static_cast<CodeValue>(value); }
+
+		const Operator& getOperator() const;
+
+		size_t childCount() const;
+	};
+
+	class Tree
+	{
+	private:
+		std::vector<Node> _nodes;
+		SymbolTable* _symbols;
+
+	public:
+		Tree();
+		Tree(SymbolTable& symbols);
+		Tree(const Tree&) = default;
+		Tree(Tree&&) noexcept = default;
+		~Tree();
+
+		Tree& operator= (const Tree&) = default;
+		Tree& operator= (Tree&&) noexcept = default;
+
+		size_t size() const;
+		bool empty() const;
+		void reserve(size_t count);
+		void clear();
+
+		const SymbolTable& symbols() const;
+
+		const Node& get(NodeRef ref) const;
+		inline const Node& operator[] (NodeRef ref) const { return _nodes[ref]; }
+
+		NodeRef identifier(Symbol symbol, NodeId source = INVALID_NODE);
+		NodeRef integer(FieldValue value, NodeId source = INVALID_NODE);
+		NodeRef constant(CodeValue value, NodeId source = INVALID_NODE);
+		NodeRef unary(const Operator& op, NodeRef operand, NodeId source = INVALID_NODE);
+		NodeRef binary(const Operator& op, NodeRef left, NodeRef right, NodeId source = INVALID_NODE);
+		NodeRef assignment(const Operator& op, NodeRef left, NodeRef right, NodeId source = INVALID_NODE);
+		NodeRef ternary(NodeRef condition, NodeRef ifTrue, NodeRef ifFalse, NodeId source = INVALID_NODE);
+
+		/*
+		 * Appends the flat form of statement, children first, and returns its root. source is the occurrence of
+		 * statement in sources; every flat node gets the occurrence of its own operand.
+		 */
+		NodeRef add(const Statement& statement, NodeId source = INVALID_NODE, const SourceMap* sources = SourceMap::current());
+
+		std::string toString(NodeRef root) const;
+
+		/* Calls fn(ref, node) for every node in id order, which always puts children before their parents */
+		template<typename _Fn>
+		void scan(_Fn&& fn) const
+		{
+			const NodeRef count = static_cast<NodeRef>(_nodes.size());
+			for (NodeRef ref = 0; ref < count; ++ref)
+				fn(ref, _nodes[ref]);
+		}
+
+	private:
+		NodeRef push(const Node& node);
+		NodeRef operation(NodeKind kind, const Operator& op, NodeRef c0, NodeRef c1, NodeRef c2, NodeId source);
+	};
+
+
+
+	/* Static visitor. _Derived defines the visitXxx it cares about; the rest fall back to visitNode. */
+	template<class _Derived, typename _Result = void>
+	class Visitor
+	{
+	public:
+		_Result visit(const Tree& tree, NodeRef ref)
+		{
+			_Derived& self = static_cast<_Derived&>(*this);
+			const Node& node = tree[ref];
+			switch (node.kind)
+			{
+				case NodeKind::Identifier: return self.visitIdentifier(tree, ref, node);
+				case NodeKind::Integer: return self.visitInteger(tree, ref, node);
+				case NodeKind::Constant: return self.visitConstant(tree, ref, node);
+				case NodeKind::Unary: return self.visitUnary(tree, ref, node);
+				case NodeKind::Binary: return self.visitBinary(tree, ref, node);
+				case NodeKind::Assignment: return self.visitAssignment(tree, ref, node);
+				case NodeKind::Ternary: return self.visitTernary(tree, ref, node);
+			}
+			throw IllegalState{ "Unknown ast node kind" };
+		}
+
+		inline _Result visitNode(const Tree&, NodeRef, const Node&) { return _Result(); }
+
+		inline _Result visitIdentifier(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+		inline _Result visitInteger(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+		inline _Result visitConstant(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+		inline _Result visitUnary(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+		inline _Result visitBinary(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+		inline _Result visitAssignment(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+		inline _Result visitTernary(const Tree& tree, NodeRef ref, const Node& node) { return static_cast<_Derived&>(*this).visitNode(tree, ref, node); }
+	};
+}
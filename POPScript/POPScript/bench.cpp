@@ -0,0 +1,262 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <regex>
+#include <vector>
+#include <streambuf>
+#include <istream>
+
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+
+namespace bench
+{
+	static std::string repeat(const char* term, const char* last, size_t terms)
+	{
+		std::string code;
+		for (size_t i = 1; i < terms; ++i)
+			code += term;
+		return code += last;
+	}
+
+	static std::string chain(size_t terms) { return repeat("a * b + ", "z", terms); }
+
+	static double elapsed(std::chrono::steady_clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	void nodeAllocations(std::ostream& os, size_t terms)
+	{
+		const std::string code = chain(terms);
+		SymbolTable symbols;
+		SymbolTable::Scope symbolScope{ symbols };
+		const lexer::TokenStream tokens = lexer::tokenize(code.data(), code.size(), symbols);
+
+		os << "parsing " << terms << " terms, " << tokens.size() << " tokens" << std::endl;
+
+		size_t heap = NodeArena::heapAllocations();
+		auto start = std::chrono::steady_clock::now();
+		parser::statement::parse(tokens, 0, tokens.size());
+		os << "heap:  " << NodeArena::heapAllocations() - heap << " heap allocations, " << elapsed(start) << " ms" << std::endl;
+
+		NodeArena arena;
+		{
+			NodeArena::Scope arenaScope{ arena };
+			heap = NodeArena::heapAllocations();
+			start = std::chrono::steady_clock::now();
+			parser::statement::parse(tokens, 0, tokens.size());
+			os << "arena: " << NodeArena::heapAllocations() - heap << " heap allocations, " << arena.allocations() << " node allocations in "
+				<< arena.blocks() << " blocks (" << arena.bytes() << " bytes), " << elapsed(start) << " ms, " << arena.live() << " nodes left" << std::endl;
+		}
+	}
+
+	/* Operations print as (operator operands...), so the text shows the shape of the tree */
+	static std::string tree(const Statement& statement)
+	{
+		if (!statement.is(CodeFragmentType::Operation))
+			return statement.toString();
+
+		const Operation& op = statement.as<Operation>();
+		const Operator& oper = op.getOperator();
+		std::string text = "(" + oper.toString();
+		if (oper.isUnary())
+			text += oper.hasRightToLeft() ? "pre" : "post";
+		for (size_t i = 0; i < op.getOperandCount(); ++i)
+			text += " " + tree(op.getOperand(i));
+		return text + ")";
+	}
+
+	static std::string parseTree(const std::string& code)
+	{
+		SymbolTable symbols;
+		SymbolTable::Scope symbolScope{ symbols };
+		try
+		{
+			const lexer::TokenStream tokens = lexer::tokenize(code.data(), code.size(), symbols);
+			return tree(parser::statement::parse(tokens, 0, tokens.size()));
+		}
+		catch (const ParserError&) { return "ParserError"; }
+		catch (const std::exception&) { return "exception"; }
+	}
+
+	static std::string trim(const std::string& text)
+	{
+		const size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+			return "";
+		return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+	}
+
+	bool statementCorpus(std::istream& corpus, std::ostream& os)
+	{
+		size_t checked = 0, failed = 0, lineNumber = 0;
+		std::string line;
+		while (std::getline(corpus, line))
+		{
+			++lineNumber;
+			const size_t arrow = line.rfind("=>");
+			if (line.empty() || line[0] == '#' || arrow == std::string::npos)
+				continue;
+
+			const std::string code = trim(line.substr(0, arrow));
+			const std::string expected = trim(line.substr(arrow + 2));
+			const std::string found = parseTree(code);
+			++checked;
+			if (found != expected)
+			{
+				++failed;
+				os << "line " << lineNumber << ": " << code << std::endl
+					<< "  expected " << expected << std::endl
+					<< "  found    " << found << std::endl;
+			}
+		}
+
+		os << checked - failed << "/" << checked << " statements match" << std::endl;
+		return failed == 0;
+	}
+
+	static double parseTime(const std::string& code)
+	{
+		SymbolTable symbols;
+		SymbolTable::Scope symbolScope{ symbols };
+		const lexer::TokenStream tokens = lexer::tokenize(code.data(), code.size(), symbols);
+
+		/* The nested ternaries go deeper than the default nesting limit */
+		const auto start = std::chrono::steady_clock::now();
+		parser::statement::parse(tokens, 0, tokens.size(), 16 * 1024);
+		return elapsed(start);
+	}
+
+	void statementParsing(std::ostream& os)
+	{
+		for (size_t terms : { 1000, 2000, 4000, 8000 })
+		{
+			os << std::setw(5) << terms << " terms: chain " << parseTime(chain(terms)) << " ms, ternary "
+				<< parseTime(repeat("c ? d : ", "e", terms)) << " ms" << std::endl;
+		}
+	}
+
+	/* The same words go through both paths; the regex path is the one Identifier and LiteralInteger used before */
+	static const std::vector<std::string> literal_words{
+		"MyMana", "BluePeople", "_counter", "INT_SPELL_TYPE", "a1b2c3", "x",
+		"0", "7", "1024", "0755", "0x1F", "0XdeadBEE", "2147483647", "123456"
+	};
+
+	static int regex_integer_base(const std::string& str)
+	{
+		if (str.size() <= 1 || str[0] != '0')
+			return 10;
+		return str[1] == 'x' || str[1] == 'X' ? 16 : 8;
+	}
+
+	void literalRecognition(std::ostream& os, size_t rounds)
+	{
+		static const std::regex identifier_pattern{ "[_a-zA-Z][_a-zA-Z0-9]*" };
+		static const std::regex integer_pattern{ "(0|0[xX])?[0-9]+" };
+
+		size_t identifiers = 0;
+		long long sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < rounds; ++i)
+		{
+			for (const std::string& word : literal_words)
+			{
+				if (std::regex_search(word, identifier_pattern) && !(word[0] >= '0' && word[0] <= '9'))
+					++identifiers;
+				else if (std::regex_search(word, integer_pattern))
+					sum += std::stol(word, nullptr, regex_integer_base(word));
+			}
+		}
+		const double regexTime = elapsed(start);
+		os << "regex:       " << regexTime << " ms (" << identifiers << " identifiers, sum " << sum << ")" << std::endl;
+
+		identifiers = 0;
+		sum = 0;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < rounds; ++i)
+		{
+			for (const std::string& word : literal_words)
+			{
+				FieldValue value;
+				if (Identifier::isValid(word.data(), word.data() + word.size()))
+					++identifiers;
+				else if (LiteralInteger::tryParse(word.data(), word.data() + word.size(), value))
+					sum += value;
+			}
+		}
+		const double recognizerTime = elapsed(start);
+		os << "recognizers: " << recognizerTime << " ms (" << identifiers << " identifiers, sum " << sum << ")" << std::endl;
+		os << rounds * literal_words.size() << " words, " << regexTime / recognizerTime << "x faster" << std::endl;
+	}
+
+	/* Source generated a line at a time and read like a pipe: a line is gone once it was read */
+	class GeneratedSource : public std::streambuf
+	{
+	private:
+		std::string _line;
+		size_t _remaining;
+
+	public:
+		GeneratedSource(size_t lines) : _line{}, _remaining{ lines } {}
+
+	protected:
+		int_type underflow() override
+		{
+			if (_remaining == 0)
+				return traits_type::eof();
+
+			--_remaining;
+			_line = "var a" + std::to_string(_remaining % 97) + " = 0x1F + b * 3; /* generated */ // statement\n";
+			setg(_line.data(), _line.data(), _line.data() + _line.size());
+			return traits_type::to_int_type(_line[0]);
+		}
+	};
+
+	struct StreamUsage
+	{
+		size_t tokens;
+		size_t peakBytes;
+	};
+
+	static StreamUsage lexStream(size_t lines)
+	{
+		GeneratedSource source{ lines };
+		std::istream is{ &source };
+		StreamCodeReader reader{ is };
+
+		SymbolTable symbols;
+		lexer::StreamLexer lex{ reader, symbols };
+		lexer::TokenStream tokens;
+
+		/* The window is allocated once; the line text and the tokens are what could grow */
+		const size_t window = reader.lookback() + reader.lookahead() + 1;
+		constexpr size_t tokenBytes = sizeof(lexer::TokenKind) + 3 * sizeof(uint32_t);
+
+		StreamUsage usage{ 0, 0 };
+		while (lex.next(tokens))
+		{
+			usage.tokens += tokens.size();
+			const size_t held = window + std::string_view{ tokens.source() }.size() + tokens.size() * tokenBytes;
+			usage.peakBytes = std::max(usage.peakBytes, held);
+		}
+		return usage;
+	}
+
+	bool streamMemory(std::ostream& os, size_t lines)
+	{
+		const StreamUsage small = lexStream(lines);
+		const StreamUsage large = lexStream(lines * 16);
+
+		os << lines << " lines: " << small.tokens << " tokens, peak " << small.peakBytes << " bytes" << std::endl;
+		os << lines * 16 << " lines: " << large.tokens << " tokens, peak " << large.peakBytes << " bytes" << std::endl;
+
+		const bool bounded = large.peakBytes == small.peakBytes;
+		os << (bounded ? "memory is bounded" : "memory grows with the stream") << std::endl;
+		return bounded;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+
+/* Measurements run from the command line, see main */
+namespace bench
+{
+	/* Node allocations and time of parsing one expression of the given number of terms, on the heap and in a NodeArena */
+	void nodeAllocations(std::ostream& os, size_t terms = 4000);
+
+	/* Parses every 'expression => tree' line of corpus and reports the trees that differ. True if none does. */
+	bool statementCorpus(std::istream& corpus, std::ostream& os);
+
+	/* Time of parsing operator chains and nested ternaries of growing length */
+	void statementParsing(std::ostream& os);
+
+	/*
+	 * Lexes a generated stream of the given number of lines, and one sixteen times longer, with a StreamLexer and
+	 * reports the most memory the reader and the tokens held. True if it did not grow with the stream.
+	 */
+	bool streamMemory(std::ostream& os, size_t lines = 100000);
+
+	/* Time of Identifier::isValid and LiteralInteger::tryParse against the std::regex_search and std::stol they replace */
+	void literalRecognition(std::ostream& os, size_t rounds = 20000);
+}
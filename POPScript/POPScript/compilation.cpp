@@ -0,0 +1,25 @@
+#include "compilation.h"
+
+Compilation::Scope::Scope(Compilation& compilation) :
+	_arena{ compilation._arena },
+	_symbols{ compilation._symbols },
+	_sources{ compilation._sources },
+	_statements{ compilation._statements }
+{}
+Compilation::Scope::~Scope() {}
+
+
+
+
+Compilation::Compilation() :
+	_arena{},
+	_symbols{},
+	_sources{},
+	_statements{}
+{}
+Compilation::~Compilation() {}
+
+NodeArena& Compilation::arena() { return _arena; }
+SymbolTable& Compilation::symbols() { return _symbols; }
+SourceMap& Compilation::sources() { return _sources; }
+StatementTable& Compilation::statements() { return _statements; }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "arena.h"
+#include "symbols.h"
+#include "spans.h"
+#include "hashcons.h"
+
+/*
+ * Per-compilation state: the node arena, symbols, source spans and statement table, made current together by a
+ * Scope. Spans are kept per occurrence in the SourceMap, so equal statements are shared while they are recorded.
+ * The arena is declared first so it outlives the table that holds nodes.
+ */
+class Compilation
+{
+public:
+	/* Makes every part of a compilation the current one of the calling thread while alive */
+	class Scope
+	{
+	private:
+		NodeArena::Scope _arena;
+		SymbolTable::Scope _symbols;
+		SourceMap::Scope _sources;
+		StatementTable::Scope _statements;
+
+	public:
+		Scope(Compilation& compilation);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+	};
+
+private:
+	NodeArena _arena;
+	SymbolTable _symbols;
+	SourceMap _sources;
+	StatementTable _statements;
+
+public:
+	Compilation();
+	~Compilation();
+
+	Compilation(const Compilation&) = delete;
+	Compilation(Compilation&&) = delete;
+
+	Compilation& operator= (const Compilation&) = delete;
+	Compilation& operator= (Compilation&&) = delete;
+
+	NodeArena& arena();
+	SymbolTable& symbols();
+	SourceMap& sources();
+	StatementTable& statements();
+};
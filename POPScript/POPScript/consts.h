@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 
 #define DECL_STATIC_BLOCK(class_name) static int class_name##__static__
 #define STATIC_BLOCK(class_name) int class_name :: class_name##__static__ = []() -> int {
@@ -9,6 +10,8 @@
 #define NO_COMMANDS 27U
 #define TOKEN_OFFSET 1000U
 #define INT_OFFSET 1000U
+#define CODE_VALUE_LIMIT 2048U
+#define STATEMENT_NESTING_LIMIT 1024U
 
 
 typedef uint8_t byte_t;
@@ -45,6 +48,48 @@ struct ScriptCode
 	constexpr static ScriptCode internal(CodeValue code) { return { CodeType::Internal, code }; }
 };
 
+/* Flat table with one slot per possible CodeValue. Missing values read as a value-initialized _Ty. */
+template<typename _Ty>
+class CodeTable
+{
+private:
+	_Ty _values[CODE_VALUE_LIMIT];
+
+public:
+	constexpr CodeTable() : _values{} {}
+
+	inline _Ty get(CodeValue code) const { return code < CODE_VALUE_LIMIT ? _values[code] : _Ty{}; }
+
+	inline bool set(CodeValue code, const _Ty& value)
+	{
+		if (code >= CODE_VALUE_LIMIT)
+			return false;
+		_values[code] = value;
+		return true;
+	}
+
+	inline _Ty operator[] (CodeValue code) const { return get(code); }
+
+	static constexpr size_t size() { return CODE_VALUE_LIMIT; }
+};
+
+/* Pair of CodeTables, one for token codes and another for internal codes */
+template<typename _Ty>
+class ScriptCodeTable
+{
+private:
+	CodeTable<_Ty> _tokens;
+	CodeTable<_Ty> _internals;
+
+public:
+	constexpr ScriptCodeTable() : _tokens{}, _internals{} {}
+
+	inline _Ty get(const ScriptCode& code) const { return code.isToken() ? _tokens.get(code.value) : _internals.get(code.value); }
+	inline bool set(const ScriptCode& code, const _Ty& value) { return code.isToken() ? _tokens.set(code.value, value) : _internals.set(code.value, value); }
+
+	inline _Ty operator[] (const ScriptCode& code) const { return get(code); }
+};
+
 enum class FieldType : uint32_t
 {
 	Constant = 0,
@@ -0,0 +1,58 @@
+#include "hashcons.h"
+
+static thread_local StatementTable* current_table = nullptr;
+
+StatementTable::Scope::Scope(StatementTable& table) :
+	_previous{ current_table }
+{
+	current_table = &table;
+}
+StatementTable::Scope::~Scope() { current_table = _previous; }
+
+
+
+
+StatementTable::StatementTable() :
+	_nodes{},
+	_hits{ 0 }
+{}
+StatementTable::~StatementTable() {}
+
+CloneableAllocator<Statement> StatementTable::intern(const Statement& statement)
+{
+	const size_t hash = statement.structuralHash();
+	auto range = _nodes.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		/* Operands are interned before their operations, so equal operands are the same node and compare in O(1) */
+		if (it->second == statement)
+		{
+			_hits++;
+			return it->second;
+		}
+	}
+
+	CloneableAllocator<Statement> node{ statement };
+	_nodes.emplace(hash, node);
+	return node;
+}
+
+bool StatementTable::has(const Statement& statement) const
+{
+	auto range = _nodes.equal_range(statement.structuralHash());
+	for (auto it = range.first; it != range.second; ++it)
+		if (it->second == statement)
+			return true;
+	return false;
+}
+
+size_t StatementTable::size() const { return _nodes.size(); }
+void StatementTable::clear()
+{
+	_nodes.clear();
+	_hits = 0;
+}
+
+size_t StatementTable::hits() const { return _hits; }
+
+StatementTable* StatementTable::current() { return current_table; }
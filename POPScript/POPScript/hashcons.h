@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "parser_elements.h"
+
+/*
+ * Hash-consing table of statements: structurally equal subtrees are stored once and shared by every
+ * CloneableAllocator that interns them. Nodes carry no source location, so sharing one loses nothing: the
+ * SourceMap keeps the span of every occurrence.
+ */
+class StatementTable
+{
+public:
+	/* Makes a table the current one of the calling thread while alive */
+	class Scope
+	{
+	private:
+		StatementTable* _previous;
+
+	public:
+		Scope(StatementTable& table);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+	};
+
+private:
+	std::unordered_multimap<size_t, CloneableAllocator<Statement>> _nodes;
+	size_t _hits;
+
+public:
+	StatementTable();
+	~StatementTable();
+
+	StatementTable(const StatementTable&) = delete;
+	StatementTable(StatementTable&&) = delete;
+
+	StatementTable& operator= (const StatementTable&) = delete;
+	StatementTable& operator= (StatementTable&&) = delete;
+
+	/* Node structurally equal to statement, which is added first if there is none */
+	CloneableAllocator<Statement> intern(const Statement& statement);
+
+	bool has(const Statement& statement) const;
+
+	size_t size() const;
+	void clear();
+
+	/* Interns that found an existing node */
+	size_t hits() const;
+
+public:
+	/* Table of the running compilation, or nullptr if statements are not being shared */
+	static StatementTable* current();
+};
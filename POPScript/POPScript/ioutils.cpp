@@ -2,35 +2,51 @@
 
 #include <sstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "utils.h"
+#include "scanutils.h"
 
 
-Line::Line() :
-	_num{},
-	_offset{},
-	_len{},
-	_endset{},
-	_chars{}
+FileMappingError::FileMappingError(const char* msg) :
+	exception{ msg }
 {}
-Line::Line(size_t num, size_t offset, const std::string& buffer) :
-	_num{ num },
+
+static std::string WindowExceeded_GenerateMsg(size_t offset, size_t windowStart, size_t windowEnd)
+{
+	std::stringstream ss;
+	ss << "Source offset " << offset << " is outside of the streaming window [" << windowStart << ", " << windowEnd
+		<< "). Increase the lookback/lookahead limits of the StreamCodeReader.";
+	return ss.str();
+}
+
+WindowExceeded::WindowExceeded(size_t offset, size_t windowStart, size_t windowEnd) :
+	exception{ WindowExceeded_GenerateMsg(offset, windowStart, windowEnd).c_str() },
 	_offset{ offset },
-	_len{ buffer.size() + 1 },
-	_endset{ offset + buffer.size() },
-	_chars{ buffer }
+	_windowStart{ windowStart },
+	_windowEnd{ windowEnd }
 {}
-Line::~Line() {}
 
-size_t Line::lineNumber() const { return _num; }
-size_t Line::offset() const { return _offset; }
-size_t Line::endset() const { return _endset; }
+size_t WindowExceeded::offset() const { return _offset; }
+size_t WindowExceeded::windowStart() const { return _windowStart; }
+size_t WindowExceeded::windowEnd() const { return _windowEnd; }
 
-size_t Line::size() const { return _len; }
 
-const std::string& Line::chars() const { return _chars; }
 
-char Line::operator[] (const size_t idx) const { return idx == _len - 1 ? '\n' : _chars[idx]; }
 
 
 
@@ -38,249 +54,691 @@ char Line::operator[] (const size_t idx) const { return idx == _len - 1 ? '\n' :
 
 
 
+MappedFile::MappedFile() :
+	_data{ nullptr },
+	_size{},
+	_handle{ nullptr }
+{}
+MappedFile::MappedFile(const std::string& path) :
+	MappedFile{}
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw FileMappingError{ "Cannot open source file" };
 
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		throw FileMappingError{ "Cannot read source file size" };
+	}
+	_size = static_cast<size_t>(size.QuadPart);
 
+	if (_size > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			throw FileMappingError{ "Cannot map source file" };
 
-CodeReader::CodeReader() :
-	_source{},
-	_index{},
-	_size{},
-	_start{},
-	_lcur{ nullptr }
-{}
-CodeReader::CodeReader(const CodeReader& cr) :
-	_source{ cr._source },
-	_index{ cr._index },
-	_size{ cr._size },
-	_start{ cr._start },
-	_lcur{ &_source[cr._lcur->lineNumber()] }
-{}
-CodeReader::~CodeReader() {}
+		_data = reinterpret_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!_data)
+		{
+			CloseHandle(mapping);
+			throw FileMappingError{ "Cannot map source file" };
+		}
+		_handle = mapping;
+	}
+	else CloseHandle(file);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw FileMappingError{ "Cannot open source file" };
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		throw FileMappingError{ "Cannot read source file size" };
+	}
+	_size = static_cast<size_t>(st.st_size);
 
-CodeReader& CodeReader::operator= (const CodeReader& cr)
+	if (_size > 0)
+	{
+		void* addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (addr == MAP_FAILED)
+			throw FileMappingError{ "Cannot map source file" };
+
+		::madvise(addr, _size, MADV_SEQUENTIAL);
+		_data = reinterpret_cast<const char*>(addr);
+		_handle = addr;
+	}
+	else ::close(fd);
+#endif
+
+	if (!_data)
+		_data = "";
+}
+MappedFile::MappedFile(MappedFile&& mf) noexcept :
+	_data{ mf._data },
+	_size{ mf._size },
+	_handle{ mf._handle }
 {
-	_source = cr._source;
-	_index = cr._index;
-	_size = cr._size;
-	_start = cr._start;
-	_lcur = &_source[cr._lcur->lineNumber()];
+	mf._data = nullptr;
+	mf._size = 0;
+	mf._handle = nullptr;
+}
+MappedFile::~MappedFile() { close(); }
+
+MappedFile& MappedFile::operator= (MappedFile&& mf) noexcept
+{
+	close();
+	_data = mf._data;
+	_size = mf._size;
+	_handle = mf._handle;
+	mf._data = nullptr;
+	mf._size = 0;
+	mf._handle = nullptr;
 	return *this;
 }
 
-#define BUFFER_LEN 8192
-static std::vector<Line> readlines(std::istream& is)
+bool MappedFile::isOpen() const { return _data; }
+
+const char* MappedFile::data() const { return _data; }
+size_t MappedFile::size() const { return _size; }
+
+bool MappedFile::isZeroTerminated() const
+{
+	if (!_handle)
+		return true;
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const size_t page = info.dwPageSize;
+#else
+	const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+	/* The tail of the last mapped page is zero filled */
+	return _size % page != 0;
+}
+
+void MappedFile::close()
 {
-	std::string sline;
-	size_t index = 1;
-	size_t size = 0;
-	
-	while (is)
+	if (_handle)
 	{
-		std::getline(is, sline);
-		
+#ifdef _WIN32
+		UnmapViewOfFile(_data);
+		CloseHandle(reinterpret_cast<HANDLE>(_handle));
+#else
+		::munmap(_handle, _size);
+#endif
 	}
+	_data = nullptr;
+	_size = 0;
+	_handle = nullptr;
 }
-#undef BUFFER_LEN
 
-void CodeReader::load(std::istream& is)
+
+
+
+
+
+
+
+
+
+LineIndex::LineIndex() :
+	_starts{ 0 },
+	_size{}
+{}
+LineIndex::LineIndex(const char* data, size_t size) :
+	_starts{ 0 },
+	_size{ size }
 {
-	this->~CodeReader();
-	new(this) CodeReader{};
+	if (size > std::numeric_limits<uint32_t>::max())
+		throw FileMappingError{ "Source files larger than 4GB are not supported" };
 
-	std::string sline;
-	_index = 1;
-	_size = 0;
+	const char* const end = data + size;
+	for (const char* ptr = data; (ptr = reinterpret_cast<const char*>(std::memchr(ptr, '\n', end - ptr))); )
+		_starts.push_back(static_cast<uint32_t>(++ptr - data));
+}
+LineIndex::~LineIndex() {}
 
-	while (is)
-	{
-		std::getline(is, sline);
-		size_t old = _size;
-		_size += sline.size() + 1;
-		++_index;
-		_source.emplace_back(_index, old, sline);
-	}
+size_t LineIndex::lineCount() const { return _starts.size(); }
+size_t LineIndex::sourceSize() const { return _size; }
+
+size_t LineIndex::lineOffset(size_t line) const
+{
+	if (line < 1 || line > _starts.size())
+		throw BadIndex{ line, 1, _starts.size() };
+	return _starts[line - 1];
+}
+size_t LineIndex::lineEndOffset(size_t line) const
+{
+	if (line < 1 || line > _starts.size())
+		throw BadIndex{ line, 1, _starts.size() };
+	return line == _starts.size() ? _size : _starts[line];
+}
+
+size_t LineIndex::lineOf(size_t offset) const
+{
+	if (offset > _size)
+		throw BadIndex{ offset, 0, _size };
+	return static_cast<size_t>(std::upper_bound(_starts.begin(), _starts.end(), offset) - _starts.begin());
+}
+size_t LineIndex::columnOf(size_t offset) const { return offset - _starts[lineOf(offset) - 1] + 1; }
+
+LineIndex::Position LineIndex::positionOf(size_t offset) const
+{
+	const size_t line = lineOf(offset);
+	return { line, offset - _starts[line - 1] + 1 };
+}
+
+size_t LineIndex::offsetOf(size_t line, size_t column) const
+{
+	const size_t offset = lineOffset(line) + column - 1;
+	if (column < 1 || offset > lineEndOffset(line))
+		throw BadIndex{ column, 1, lineEndOffset(line) - lineOffset(line) + 1 };
+	return offset;
+}
 
+
+
+
+
+
+
+
+
+
+CodeReader::CodeReader() :
+	_src{},
+	_data{ nullptr },
+	_index{ INVALID_INDEX },
+	_size{},
+	_start{}
+{}
+CodeReader::~CodeReader() {}
+
+void CodeReader::attach(std::shared_ptr<Source> src)
+{
+	src->lines = { src->data, src->size };
+
+	_data = src->data;
+	_size = src->size;
+	_src = std::move(src);
 	_index = INVALID_INDEX;
 	_start = 0;
-	_lcur = nullptr;
+}
+
+void CodeReader::load(std::istream& is)
+{
+	auto src = std::make_shared<Source>();
+	src->buffer.assign(std::istreambuf_iterator<char>{ is }, std::istreambuf_iterator<char>{});
+	src->data = src->buffer.data();
+	src->size = src->buffer.size();
+	attach(std::move(src));
 }
 
 void CodeReader::load(const std::string& str)
 {
-	std::istringstream iss{ str };
-	load(iss);
+	auto src = std::make_shared<Source>();
+	src->buffer = str;
+	src->data = src->buffer.data();
+	src->size = src->buffer.size();
+	attach(std::move(src));
+}
+
+void CodeReader::loadMapped(const std::string& path)
+{
+	auto src = std::make_shared<Source>();
+	src->mapping = MappedFile{ path };
+	if (src->mapping.isZeroTerminated())
+		src->data = src->mapping.data();
+	else
+	{
+		src->buffer.assign(src->mapping.data(), src->mapping.size());
+		src->mapping.close();
+		src->data = src->buffer.data();
+	}
+	src->size = src->buffer.empty() ? src->mapping.size() : src->buffer.size();
+	attach(std::move(src));
 }
 
 CodeReader CodeReader::subpart(size_t from, size_t to) const
 {
-	CodeReader cr;
-	cr.setIndex(from);
-	cr._index = cr._start = from;
+	if (from > to || to > _size)
+		throw BadIndex{ to, from, _size };
+
+	CodeReader cr{ *this };
+	cr._index = INVALID_INDEX;
+	cr._start = from;
 	cr._size = to;
-	return std::move(cr);
+	return cr;
 }
 
-size_t CodeReader::currentLine() const { return !_lcur || _source.empty() ? 0 : _lcur->lineNumber(); }
+size_t CodeReader::currentLine() const { return !_src || _index == INVALID_INDEX ? 0 : _src->lines.lineOf(_index); }
+size_t CodeReader::currentColumn() const { return !_src || _index == INVALID_INDEX ? 0 : _src->lines.columnOf(_index); }
+LineIndex::Position CodeReader::currentPosition() const
+{
+	if (!_src || _index == INVALID_INDEX)
+		return { 0, 0 };
+	return _src->lines.positionOf(_index);
+}
 
-void CodeReader::reset()
+const LineIndex& CodeReader::lineIndex() const
 {
-	_index = INVALID_INDEX;
-	_lcur = nullptr;
+	if (!_src)
+		throw IllegalState{ "CodeReader has no source loaded" };
+	return _src->lines;
+}
+
+void CodeReader::reset() { _index = INVALID_INDEX; }
+
+bool CodeReader::tryNext(char& c)
+{
+	const size_t to = nextIndex();
+	if (to >= _size)
+		return false;
+	_index = to;
+	c = _data[to];
+	return true;
+}
+bool CodeReader::tryMove(intmax_t positions)
+{
+	const size_t to = static_cast<size_t>(_index + positions);
+	if (!inRange(to))
+		return false;
+	_index = to;
+	return true;
+}
+
+char CodeReader::peekOr(char defaultValue) const { return inRange(_index) ? _data[_index] : defaultValue; }
+char CodeReader::peekOr(intmax_t positions, char defaultValue) const
+{
+	const size_t to = static_cast<size_t>(_index + positions);
+	return inRange(to) ? _data[to] : defaultValue;
 }
 
 char CodeReader::next()
 {
-	if (_source.empty() || ( _index != INVALID_INDEX && _index >= _size))
+	char c;
+	if (!tryNext(c))
+		throw EOFException{};
+	return c;
+}
+
+std::string CodeReader::nextString(size_t count) { return std::string{ nextStringView(count) }; }
+
+std::string_view CodeReader::nextStringView(size_t count)
+{
+	if (count == 0)
+		return {};
+
+	const size_t from = nextIndex();
+	if (from + count > _size)
 		throw EOFException{};
-	if (_index == INVALID_INDEX)
+	_index = from + count - 1;
+	return { _data + from, count };
+}
+
+char CodeReader::peek() const { return peekTo(_index); }
+char CodeReader::peek(intmax_t positions) const { return peekTo(static_cast<size_t>(_index + positions)); }
+bool CodeReader::canPeek(intmax_t positions) const { return inRange(static_cast<size_t>(_index + positions)); }
+
+char CodeReader::peekTo(size_t to) const
+{
+	if (!inRange(to))
+		throw BadIndex{ to, _start, _size };
+	return _data[to];
+}
+char CodeReader::moveTo(size_t to)
+{
+	const char c = peekTo(to);
+	_index = to;
+	return c;
+}
+
+void CodeReader::move(intmax_t positions)
+{
+	if (!tryMove(positions))
+		throw EOFException{};
+}
+
+void CodeReader::seekOrEnd(char c)
+{
+	const size_t from = nextIndex();
+	if (from >= _size)
+		return;
+
+	const char* const end = _data + _size;
+	const char* found = c == '\n'
+		? scan::findNewline(_data + from, end)
+		: reinterpret_cast<const char*>(std::memchr(_data + from, c, _size - from));
+	_index = found && found != end ? static_cast<size_t>(found - _data) : _size - 1;
+}
+
+void CodeReader::seekOrEnd(char c1, char c2)
+{
+	size_t from = nextIndex();
+	if (from >= _size)
+		return;
+
+	if (c1 == '*' && c2 == '/')
 	{
-		_index = 0;
-		_lcur = &_source[0];
-		if (_lcur->chars().empty() || _index == _lcur->chars().size())
-			return '\n';
-		return (*_lcur)[_index];
+		const char* const end = _data + _size;
+		const char* found = scan::findBlockCommentEnd(_data + from, end);
+		_index = found != end ? static_cast<size_t>(found - _data) + 1 : _size - 1;
+		return;
 	}
-	++_index;
-	size_t offset = _index - _lcur->offset();
-	if (offset == _lcur->chars().size())
-		return '\n';
-	if (offset > _lcur->chars().size())
+
+	while (from < _size)
 	{
-		if (_lcur->lineNumber() >= _source.size())
-			throw EOFException{};
-		_lcur = &_source[_lcur->lineNumber()];
-		offset = _index - _lcur->offset();
-		if (_lcur->chars().empty() || offset == _lcur->chars().size())
-			return '\n';
+		const void* found = std::memchr(_data + from, c1, _size - from);
+		if (!found)
+			break;
+
+		const size_t idx = static_cast<size_t>(reinterpret_cast<const char*>(found) - _data);
+		if (idx + 1 < _size && _data[idx + 1] == c2)
+		{
+			_index = idx + 1;
+			return;
+		}
+		from = idx + 1;
 	}
-	return (*_lcur)[offset];
+	_index = _size - 1;
 }
 
-std::string CodeReader::nextString(size_t count)
+bool CodeReader::hasNext() const { return nextIndex() < _size; }
+
+const char* CodeReader::data() const { return _data; }
+
+size_t CodeReader::getMinIndex() const { return _start; }
+size_t CodeReader::getMaxIndex() const { return _size; }
+
+size_t CodeReader::getCurrentIndex() const { return _index; }
+
+char CodeReader::setIndex(size_t index) { return moveTo(index); }
+
+bool CodeReader::findIgnoreSpaces(char c) const
 {
-	std::string str(count, '\0');
-	for (size_t i = 0; i < count; ++i)
-		str[i] = next();
-	return str;
+	if (!_data)
+		return false;
+
+	const size_t from = nextIndex();
+	if (from >= _size)
+		return false;
+
+	const char* ptr = scan::skipBlanks(_data + from, _data + _size);
+	const size_t idx = static_cast<size_t>(ptr - _data);
+	if (idx >= _size || *ptr != c)
+		return false;
+
+	const_cast<CodeReader*>(this)->_index = idx;
+	return true;
 }
 
-char CodeReader::peek() const { return peekTo(_index); }
-char CodeReader::peek(intmax_t positions) const { return peekTo(static_cast<size_t>(_index + positions)); }
-bool CodeReader::canPeek(intmax_t positions) const
+
+
+
+
+
+
+
+
+
+StreamCodeReader::StreamCodeReader() :
+	_is{ nullptr },
+	_window{},
+	_lookback{},
+	_lookahead{},
+	_begin{},
+	_end{},
+	_eof{ true },
+	_index{ INVALID_INDEX },
+	_line{ 1 },
+	_linePos{}
+{}
+StreamCodeReader::StreamCodeReader(std::istream& is, size_t lookback, size_t lookahead) :
+	StreamCodeReader{}
 {
-	try { peekTo(static_cast<size_t>(_index + positions)); }
-	catch (BadIndex ex) { return false; }
+	load(is, lookback, lookahead);
+}
+StreamCodeReader::~StreamCodeReader() {}
 
-	return true;
+void StreamCodeReader::load(std::istream& is, size_t lookback, size_t lookahead)
+{
+	if (lookahead == 0)
+		throw INVALID_PARAMETER(lookahead);
+
+	_is = &is;
+	_window.assign(lookback + lookahead + 1, '\0');
+	_lookback = lookback;
+	_lookahead = lookahead;
+	_begin = 0;
+	_end = 0;
+	_eof = false;
+	_index = INVALID_INDEX;
+	_line = 1;
+	_linePos = 0;
 }
 
-size_t CodeReader::_moveTo(size_t to) const
+size_t StreamCodeReader::lookback() const { return _lookback; }
+size_t StreamCodeReader::lookahead() const { return _lookahead; }
+size_t StreamCodeReader::windowStart() const { return _begin; }
+size_t StreamCodeReader::windowEnd() const { return _end; }
+
+size_t StreamCodeReader::currentLine() const { return _index == INVALID_INDEX ? 0 : _line; }
+
+bool StreamCodeReader::ensure(size_t offset)
 {
-	if (to < _start || to >= _size)
-		throw BadIndex{ to, _start, _size };
+	if (offset < _begin)
+		throw WindowExceeded{ offset, _begin, _end };
+	if (offset < _end)
+		return true;
+	if (_eof)
+		return false;
+
+	const size_t cursor = _index == INVALID_INDEX ? 0 : _index;
+	if (offset - cursor > _lookahead)
+		throw WindowExceeded{ offset, _begin, cursor + _lookahead + 1 };
 
-	int line = !_lcur ? 0 : _lcur->lineNumber() - 1;
-	if (to == _index)
+	fill(offset);
+	return offset < _end;
+}
+
+void StreamCodeReader::fill(size_t offset)
+{
+	/* Drop everything the parser is no longer allowed to look back at */
+	const size_t cursor = _index == INVALID_INDEX ? 0 : _index;
+	const size_t keepFrom = cursor > _lookback ? cursor - _lookback : 0;
+	if (keepFrom > _begin)
+		_begin = std::min(keepFrom, _end);
+
+	const size_t capacity = _window.size();
+	while (!_eof && offset >= _end)
 	{
-		int idx = _index - _source[line].offset();
-		return idx == _source[line].chars().size()
-			? '\n'
-			: _source[line][idx];
+		const size_t free = capacity - (_end - _begin);
+		const size_t pos = _end % capacity;
+		const size_t len = std::min(free, capacity - pos);
+		if (len == 0)
+			throw WindowExceeded{ offset, _begin, _end };
+
+		/* Take what the stream already holds, and only block for the bytes asked for: a pipe may not fill the window for a long time */
+		size_t count = static_cast<size_t>(_is->readsome(&_window[pos], static_cast<std::streamsize>(len)));
+		if (count == 0)
+		{
+			const size_t needed = std::min(len, offset + 1 - _end);
+			_is->read(&_window[pos], static_cast<std::streamsize>(needed));
+			count = static_cast<size_t>(_is->gcount());
+			if (count < needed)
+				_eof = true;
+		}
+		_end += count;
 	}
+}
 
-	if (to > _index)
+void StreamCodeReader::moveCursor(size_t to)
+{
+	if (to > _linePos)
 	{
-		while (_source[line].endset() < to)
-			line++;
+		for (size_t i = _linePos; i < to; ++i)
+			if (at(i) == '\n')
+				++_line;
 	}
 	else
 	{
-		while (_source[line].offset() > to)
-			line--;
+		for (size_t i = to; i < _linePos; ++i)
+			if (at(i) == '\n')
+				--_line;
 	}
+	_linePos = to;
+	_index = to;
+}
 
-	return line;
+bool StreamCodeReader::tryNext(char& c)
+{
+	const size_t to = nextIndex();
+	if (!ensure(to))
+		return false;
+	moveCursor(to);
+	c = at(to);
+	return true;
+}
+bool StreamCodeReader::tryMove(intmax_t positions)
+{
+	const size_t to = static_cast<size_t>(_index + positions);
+	if (_index == INVALID_INDEX || !ensure(to))
+		return false;
+	moveCursor(to);
+	return true;
 }
 
-char CodeReader::peekTo(size_t to) const
+bool StreamCodeReader::nextLine(std::string& line)
 {
-	size_t line = _moveTo(to);
+	const size_t capacity = _window.size();
+	const size_t from = nextIndex();
+	size_t to = from;
+	while (ensure(to))
+	{
+		const size_t pos = to % capacity;
+		const size_t run = std::min(_end - to, capacity - pos);
+		const void* const newline = std::memchr(&_window[pos], '\n', run);
+		if (newline)
+		{
+			to += static_cast<size_t>(static_cast<const char*>(newline) - &_window[pos]) + 1;
+			break;
+		}
+		to += run;
+	}
+
+	line.clear();
+	if (to == from)
+		return false;
 
-	const Line& l = _source[line];
-	int offset = to - l.offset();
-	if (l.chars().empty() || offset == l.chars().size())
-		return '\n';
-	return l[offset];
+	for (size_t i = from; i < to;)
+	{
+		const size_t pos = i % capacity;
+		const size_t run = std::min(to - i, capacity - pos);
+		line.append(&_window[pos], run);
+		i += run;
+	}
+	moveCursor(to - 1);
+	return true;
 }
-char CodeReader::moveTo(size_t to)
+
+char StreamCodeReader::peekOr(char defaultValue) { return _index != INVALID_INDEX && ensure(_index) ? at(_index) : defaultValue; }
+char StreamCodeReader::peekOr(intmax_t positions, char defaultValue)
 {
-	size_t line = _moveTo(to);
+	const size_t to = static_cast<size_t>(_index + positions);
+	return _index != INVALID_INDEX && ensure(to) ? at(to) : defaultValue;
+}
 
-	_lcur = &_source[line];
-	_index = to;
-	int offset = _index - _lcur->offset();
-	if (_lcur->chars().empty() || offset == _lcur->chars().size())
-		return '\n';
-	return (*_lcur)[offset];
+char StreamCodeReader::next()
+{
+	char c;
+	if (!tryNext(c))
+		throw EOFException{};
+	return c;
 }
 
-void CodeReader::move(intmax_t positions)
+std::string StreamCodeReader::nextString(size_t count)
 {
-	try { moveTo(static_cast<size_t>(_index + positions)); }
-	catch (BadIndex ex) { throw EOFException{}; }
+	std::string str(count, '\0');
+	for (size_t i = 0; i < count; ++i)
+		str[i] = next();
+	return str;
 }
 
-void CodeReader::seekOrEnd(char c)
+char StreamCodeReader::peek()
 {
-	try { while (next() != c); }
-	catch (EOFException ex) {}
+	if (_index == INVALID_INDEX || !ensure(_index))
+		throw BadIndex{ _index, _begin, _end };
+	return at(_index);
 }
+char StreamCodeReader::peek(intmax_t positions)
+{
+	const size_t to = static_cast<size_t>(_index + positions);
+	if (_index == INVALID_INDEX || !ensure(to))
+		throw BadIndex{ to, _begin, _end };
+	return at(to);
+}
+bool StreamCodeReader::canPeek(intmax_t positions) { return _index != INVALID_INDEX && ensure(static_cast<size_t>(_index + positions)); }
 
-void CodeReader::seekOrEnd(char c1, char c2)
+void StreamCodeReader::move(intmax_t positions)
+{
+	if (!tryMove(positions))
+		throw EOFException{};
+}
+
+void StreamCodeReader::seekOrEnd(char c)
+{
+	char c2;
+	while (tryNext(c2) && c2 != c);
+}
+
+void StreamCodeReader::seekOrEnd(char c1, char c2)
 {
-	try
+	char c;
+	while (tryNext(c))
 	{
-		for (;;)
+		if (c == c1 && peekOr(1, '\0') == c2)
 		{
-			char c = next();
-			if (c == c1 && canPeek(1) && peek(1) == c2)
-			{
-				next();
-				return;
-			}
+			tryNext(c);
+			return;
 		}
 	}
-	catch (EOFException ex) {}
 }
 
-bool CodeReader::hasNext() const { return !_source.empty() && (_index < _size || _index == INVALID_INDEX); }
-
-size_t CodeReader::getMaxIndex() const { return _size; }
+bool StreamCodeReader::hasNext() { return ensure(nextIndex()); }
 
-size_t CodeReader::getCurrentIndex() const { return _index; }
+size_t StreamCodeReader::getCurrentIndex() const { return _index; }
 
-char CodeReader::setIndex(size_t index) { return moveTo(index); }
+char StreamCodeReader::setIndex(size_t index)
+{
+	if (!ensure(index))
+		throw BadIndex{ index, _begin, _end };
+	moveCursor(index);
+	return at(index);
+}
 
-bool CodeReader::findIgnoreSpaces(char c) const
+bool StreamCodeReader::findIgnoreSpaces(char c)
 {
-	size_t idx = _index;
-	try
+	size_t idx = nextIndex();
+	while (ensure(idx))
 	{
-		for (;;)
+		const char c2 = at(idx);
+		if (c2 == c)
 		{
-			char c2 = const_cast<CodeReader*>(this)->next();
-			if (c2 == ' ' || c2 == '\t')
-				continue;
-			if (c2 == c)
-				return true;
-			const_cast<CodeReader*>(this)->setIndex(idx);
-			return false;
+			moveCursor(idx);
+			return true;
 		}
+		if (c2 != ' ' && c2 != '\t')
+			return false;
+		++idx;
 	}
-	catch (EOFException ex)
-	{
-		const_cast<CodeReader*>(this)->setIndex(idx);
-		return false;
-	}
+	return false;
 }
-
@@ -4,37 +4,8 @@
 #include <vector>
 #include <exception>
 #include <cstdint>
-
-namespace
-{
-	class Line
-	{
-	private:
-		size_t _num;
-		size_t _offset;
-		size_t _len;
-		size_t _endset;
-
-		std::string _chars;
-
-	public:
-		Line(); 
-		Line(size_t num, size_t offset, const std::string& buffer);
-		~Line();
-
-		size_t lineNumber() const;
-		size_t offset() const;
-		size_t endset() const;
-
-		size_t size() const;
-
-		const std::string& chars() const;
-
-		char operator[] (const size_t idx) const;
-	};
-}
-
-
+#include <memory>
+#include <string_view>
 
 /*class CodeWriter
 {
@@ -71,36 +42,149 @@ public:
 
 class EOFException : std::exception {};
 
+class FileMappingError : public std::exception
+{
+public:
+	FileMappingError(const char* msg = "");
+};
+
+class WindowExceeded : public std::exception
+{
+private:
+	size_t _offset;
+	size_t _windowStart;
+	size_t _windowEnd;
+
+public:
+	WindowExceeded(size_t offset, size_t windowStart, size_t windowEnd);
+
+	size_t offset() const;
+	size_t windowStart() const;
+	size_t windowEnd() const;
+};
+
+
+
+class MappedFile
+{
+private:
+	const char* _data;
+	size_t _size;
+	void* _handle;
+
+public:
+	MappedFile();
+	explicit MappedFile(const std::string& path);
+	MappedFile(MappedFile&& mf) noexcept;
+	~MappedFile();
+
+	MappedFile& operator= (MappedFile&& mf) noexcept;
+
+	bool isOpen() const;
+
+	const char* data() const;
+	size_t size() const;
+
+	bool isZeroTerminated() const;
+
+	void close();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator= (const MappedFile&) = delete;
+};
+
+
+
+class LineIndex
+{
+public:
+	struct Position
+	{
+		size_t line;
+		size_t column;
+	};
+
+private:
+	std::vector<uint32_t> _starts;
+	size_t _size;
+
+public:
+	LineIndex();
+	LineIndex(const char* data, size_t size);
+	LineIndex(const LineIndex&) = default;
+	LineIndex(LineIndex&&) noexcept = default;
+	~LineIndex();
+
+	LineIndex& operator= (const LineIndex&) = default;
+	LineIndex& operator= (LineIndex&&) noexcept = default;
+
+	size_t lineCount() const;
+	size_t sourceSize() const;
+
+	size_t lineOffset(size_t line) const;
+	size_t lineEndOffset(size_t line) const;
+
+	size_t lineOf(size_t offset) const;
+	size_t columnOf(size_t offset) const;
+	Position positionOf(size_t offset) const;
+
+	size_t offsetOf(size_t line, size_t column) const;
+	inline size_t offsetOf(const Position& pos) const { return offsetOf(pos.line, pos.column); }
+};
+
+
+
 class CodeReader
 {
 private:
-	std::vector<Line> _source;
+	struct Source
+	{
+		std::string buffer;
+		MappedFile mapping;
+		const char* data;
+		size_t size;
+		LineIndex lines;
+	};
+
+	std::shared_ptr<const Source> _src;
+	const char* _data;
 	size_t _index;
 	size_t _size;
 	size_t _start;
-	const Line* _lcur;
 
 public:
 	CodeReader();
-	CodeReader(const CodeReader& cr);
+	CodeReader(const CodeReader& cr) = default;
 	CodeReader(CodeReader&& cr) noexcept = default;
 	~CodeReader();
 
-	CodeReader& operator= (const CodeReader& cr);
-	CodeReader& operator= (CodeReader&& cr) = default;
+	CodeReader& operator= (const CodeReader& cr) = default;
+	CodeReader& operator= (CodeReader&& cr) noexcept = default;
 
 	void load(std::istream& is);
 	void load(const std::string& str);
+	void loadMapped(const std::string& path);
 
 	CodeReader subpart(size_t from, size_t to) const;
 
 	size_t currentLine() const;
+	size_t currentColumn() const;
+	LineIndex::Position currentPosition() const;
+
+	const LineIndex& lineIndex() const;
 
 	void reset();
 
+	bool tryNext(char& c);
+	bool tryMove(intmax_t positions);
+
+	char peekOr(char defaultValue) const;
+	char peekOr(intmax_t positions, char defaultValue) const;
+
 	char next();
 
 	std::string nextString(size_t count);
+	std::string_view nextStringView(size_t count);
 
 	char peek() const;
 	char peek(intmax_t positions) const;
@@ -114,6 +198,9 @@ public:
 
 	bool hasNext() const;
 
+	const char* data() const;
+
+	size_t getMinIndex() const;
 	size_t getMaxIndex() const;
 
 	size_t getCurrentIndex() const;
@@ -124,9 +211,103 @@ public:
 
 
 private:
-	size_t _moveTo(size_t to) const;
+	void attach(std::shared_ptr<Source> src);
+
+	inline size_t nextIndex() const { return _index == INVALID_INDEX ? _start : _index + 1; }
+	inline bool inRange(size_t index) const { return index >= _start && index < _size; }
+
 	char peekTo(size_t to) const;
 	char moveTo(size_t to);
 
 	static constexpr size_t INVALID_INDEX = static_cast<size_t>(~0LL);
+
+public:
+	static constexpr char SENTINEL = '\0';
+};
+
+
+
+class StreamCodeReader
+{
+private:
+	std::istream* _is;
+	std::vector<char> _window;
+	size_t _lookback;
+	size_t _lookahead;
+	size_t _begin;
+	size_t _end;
+	bool _eof;
+
+	size_t _index;
+	size_t _line;
+	size_t _linePos;
+
+public:
+	StreamCodeReader();
+	StreamCodeReader(std::istream& is, size_t lookback = DEFAULT_LOOKBACK, size_t lookahead = DEFAULT_LOOKAHEAD);
+	StreamCodeReader(StreamCodeReader&&) noexcept = default;
+	~StreamCodeReader();
+
+	StreamCodeReader& operator= (StreamCodeReader&&) noexcept = default;
+
+	void load(std::istream& is, size_t lookback = DEFAULT_LOOKBACK, size_t lookahead = DEFAULT_LOOKAHEAD);
+
+	size_t lookback() const;
+	size_t lookahead() const;
+	size_t windowStart() const;
+	size_t windowEnd() const;
+
+	size_t currentLine() const;
+
+	bool tryNext(char& c);
+	bool tryMove(intmax_t positions);
+
+	/*
+	 * Replaces line with the text up to and including the next '\n', or up to the end of the stream, and moves
+	 * past it. False at the end of the stream. Throws WindowExceeded if the line is longer than the lookahead.
+	 */
+	bool nextLine(std::string& line);
+
+	char peekOr(char defaultValue);
+	char peekOr(intmax_t positions, char defaultValue);
+
+	char next();
+
+	std::string nextString(size_t count);
+
+	char peek();
+	char peek(intmax_t positions);
+	bool canPeek(intmax_t positions);
+
+	void move(intmax_t positions);
+
+	void seekOrEnd(char c);
+
+	void seekOrEnd(char c1, char c2);
+
+	bool hasNext();
+
+	size_t getCurrentIndex() const;
+
+	char setIndex(size_t index);
+
+	bool findIgnoreSpaces(char c);
+
+	StreamCodeReader(const StreamCodeReader&) = delete;
+	StreamCodeReader& operator= (const StreamCodeReader&) = delete;
+
+private:
+	bool ensure(size_t offset);
+	void fill(size_t offset);
+
+	inline char at(size_t offset) const { return _window[offset % _window.size()]; }
+	inline size_t nextIndex() const { return _index == INVALID_INDEX ? 0 : _index + 1; }
+
+	void moveCursor(size_t to);
+
+	static constexpr size_t INVALID_INDEX = static_cast<size_t>(~0LL);
+
+public:
+	static constexpr size_t DEFAULT_LOOKBACK = 64 * 1024;
+	static constexpr size_t DEFAULT_LOOKAHEAD = 64 * 1024;
 };
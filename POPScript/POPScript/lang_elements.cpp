@@ -73,20 +73,12 @@ const LangElement* Namespace::findChild(const std::string& name) const
 	});
 	return it == _children.end() ? nullptr : *it;
 }
-const LangElement* Namespace::findChildByCode(CodeValue code) const
+const LangElement* Namespace::findChildByCode(const ScriptCode& code) const
 {
-	const auto& it = std::find_if(_children.begin(), _children.end(), [code](LangElement* elem) {
-		switch (elem->type())
-		{
-			case Type::Object:
-			case Type::Attribute:
-			case Type::ReadOnlyAttribute:
-			case Type::Function:
-				return elem->as<Attribute>().getCode() == code;
-		}
-		return false;
-	});
-	return it == _children.end() ? nullptr : *it;
+	const Attribute* elem = ElementManager::findCodeElement(code);
+	if (!elem || !elem->hasParent() || elem->getParent() != *this)
+		return nullptr;
+	return elem;
 }
 
 LangElement::Type Namespace::type() const { return Type::Namespace; }
@@ -213,7 +205,7 @@ LangElement::Type Function::type() const { return Type::Function; }
 
 ElementAllocator ElementManager::Elements;
 std::map<std::string, const LangElement*> ElementManager::GlobalMap;
-std::map<CodeValue, const Attribute*> ElementManager::CodeMap;
+ScriptCodeTable<const Attribute*> ElementManager::CodeMap;
 
 Namespace& ElementManager::newNamespace() { return *Elements.createElement<Namespace>(); }
 Class& ElementManager::newClass() { return *Elements.createElement<Class>(); }
@@ -228,7 +220,7 @@ void ElementManager::registerGlobal(const LangElement& elem)
 }
 void ElementManager::registerCode(const Attribute& elem)
 {
-	CodeMap[elem.getCode()] = &elem;
+	CodeMap.set(elem.getCode(), &elem);
 }
 
 void ElementManager::assignTo(const Namespace& parent, LangElement& elem)
@@ -239,24 +231,24 @@ void ElementManager::assignTo(const Namespace& parent, LangElement& elem)
 
 void ElementManager::assignTo(const Class& parent, Object& elem)
 {
-	assignTo(reinterpret_cast<const Namespace&>(parent), reinterpret_cast<LangElement&>(elem));
+	assignTo(static_cast<const Namespace&>(parent), static_cast<LangElement&>(elem));
 }
 void ElementManager::assignTo(const Class& parent, Attribute& elem)
 {
-	assignTo(reinterpret_cast<const Namespace&>(parent), reinterpret_cast<LangElement&>(elem));
+	assignTo(static_cast<const Namespace&>(parent), static_cast<LangElement&>(elem));
 }
 void ElementManager::assignTo(const Class& parent, ReadOnlyAttribute& elem)
 {
-	assignTo(reinterpret_cast<const Namespace&>(parent), reinterpret_cast<LangElement&>(elem));
+	assignTo(static_cast<const Namespace&>(parent), static_cast<LangElement&>(elem));
 }
 
 void ElementManager::assignTo(const Object& parent, Attribute& elem)
 {
-	assignTo(reinterpret_cast<const Namespace&>(parent), reinterpret_cast<LangElement&>(elem));
+	assignTo(static_cast<const Namespace&>(parent), static_cast<LangElement&>(elem));
 }
 void ElementManager::assignTo(const Object& parent, ReadOnlyAttribute& elem)
 {
-	assignTo(reinterpret_cast<const Namespace&>(parent), reinterpret_cast<LangElement&>(elem));
+	assignTo(static_cast<const Namespace&>(parent), static_cast<LangElement&>(elem));
 }
 
 const Namespace& ElementManager::makeNamespace(const std::string& name)
@@ -321,11 +313,7 @@ const LangElement* ElementManager::findGlobalElement(const std::string& name)
 	return it == GlobalMap.end() ? nullptr : it->second;
 }
 
-const LangElement* ElementManager::findCodeElement(CodeValue code)
-{
-	const auto& it = CodeMap.find(code);
-	return it == CodeMap.end() ? nullptr : it->second;
-}
+const Attribute* ElementManager::findCodeElement(const ScriptCode& code) { return CodeMap[code]; }
 
 
 
@@ -337,7 +325,7 @@ const LangElement* ElementManager::findCodeElement(CodeValue code)
 namespace elements
 {
 	const LangElement* findGlobal(const std::string& name) { return ElementManager::findGlobalElement(name); }
-	const LangElement* findByCode(CodeValue code) { return ElementManager::findCodeElement(code); }
+	const LangElement* findByCode(const ScriptCode& code) { return ElementManager::findCodeElement(code); }
 
 	const LangElement* findChild(const LangElement& parent, const std::string& name)
 	{
@@ -351,7 +339,7 @@ namespace elements
 		}
 		return nullptr;
 	}
-	const LangElement* findChildByCode(const LangElement& parent, CodeValue code)
+	const LangElement* findChildByCode(const LangElement& parent, const ScriptCode& code)
 	{
 		using Type = LangElement::Type;
 		switch (parent.type())
@@ -120,7 +120,7 @@ public:
 	const LangElement& operator[] (const size_t idx) const;
 
 	const LangElement* findChild(const std::string& name) const;
-	const LangElement* findChildByCode(CodeValue code) const;
+	const LangElement* findChildByCode(const ScriptCode& code) const;
 
 	virtual LangElement::Type type() const override;
 
@@ -288,7 +288,7 @@ namespace
 	private:
 		static ElementAllocator Elements;
 		static std::map<std::string, const LangElement*> GlobalMap;
-		static std::map<CodeValue, const Attribute*> CodeMap;
+		static ScriptCodeTable<const Attribute*> CodeMap;
 
 		static Namespace& newNamespace();
 		static Class& newClass();
@@ -338,7 +338,7 @@ namespace
 
 		static const LangElement* findGlobalElement(const std::string& name);
 
-		static const LangElement* findCodeElement(CodeValue code);
+		static const Attribute* findCodeElement(const ScriptCode& code);
 	};
 }
 
@@ -347,10 +347,10 @@ namespace
 namespace elements
 {
 	const LangElement* findGlobal(const std::string& name);
-	const LangElement* findByCode(CodeValue code);
+	const LangElement* findByCode(const ScriptCode& code);
 
 	const LangElement* findChild(const LangElement& parent, const std::string& name);
-	const LangElement* findChildByCode(const LangElement& parent, CodeValue code);
+	const LangElement* findChildByCode(const LangElement& parent, const ScriptCode& code);
 }
 
 namespace elements::namespaces
@@ -0,0 +1,569 @@
+#include "lexer.h"
+
+#include <thread>
+#include <algorithm>
+#include <limits>
+
+#include "scanutils.h"
+
+namespace lexer
+{
+	TokenStream::TokenStream() :
+		TokenStream{ nullptr, nullptr }
+	{}
+	TokenStream::TokenStream(const char* source, const SymbolTable* symbols) :
+		_source{ source },
+		_symbols{ symbols },
+		_text{},
+		_firstLine{ 1 },
+		_kinds{},
+		_offsets{},
+		_lengths{},
+		_payloads{}
+	{}
+
+	size_t TokenStream::size() const { return _kinds.size(); }
+	bool TokenStream::empty() const { return _kinds.empty(); }
+
+	void TokenStream::reserve(size_t capacity)
+	{
+		_kinds.reserve(capacity);
+		_offsets.reserve(capacity);
+		_lengths.reserve(capacity);
+		_payloads.reserve(capacity);
+	}
+
+	void TokenStream::clear()
+	{
+		_kinds.clear();
+		_offsets.clear();
+		_lengths.clear();
+		_payloads.clear();
+	}
+
+	void TokenStream::push(TokenKind kind, uint32_t offset, uint32_t length, uint32_t payload)
+	{
+		_kinds.push_back(kind);
+		_offsets.push_back(offset);
+		_lengths.push_back(length);
+		_payloads.push_back(payload);
+	}
+
+	void TokenStream::append(const TokenStream& tokens)
+	{
+		_kinds.insert(_kinds.end(), tokens._kinds.begin(), tokens._kinds.end());
+		_offsets.insert(_offsets.end(), tokens._offsets.begin(), tokens._offsets.end());
+		_lengths.insert(_lengths.end(), tokens._lengths.begin(), tokens._lengths.end());
+		_payloads.insert(_payloads.end(), tokens._payloads.begin(), tokens._payloads.end());
+	}
+
+	Token TokenStream::operator[] (size_t index) const { return { _kinds[index], _offsets[index], _lengths[index], _payloads[index] }; }
+
+	const char* TokenStream::source() const { return _source; }
+	const SymbolTable* TokenStream::symbols() const { return _symbols; }
+
+	size_t TokenStream::firstLine() const { return _firstLine; }
+
+	void TokenStream::bindSymbols(SymbolTable& symbols)
+	{
+		const size_t count = _kinds.size();
+		for (size_t i = 0; i < count; ++i)
+			if (_kinds[i] == TokenKind::Identifier && _payloads[i] == INVALID_SYMBOL)
+				_payloads[i] = symbols.intern(text(i));
+		_symbols = &symbols;
+	}
+
+	bool TokenStream::operator== (const TokenStream& tokens) const
+	{
+		return _kinds == tokens._kinds && _offsets == tokens._offsets && _lengths == tokens._lengths && _payloads == tokens._payloads;
+	}
+	bool TokenStream::operator!= (const TokenStream& tokens) const { return !operator==(tokens); }
+
+
+
+
+	namespace
+	{
+		enum class CharClass : uint8_t
+		{
+			Invalid,
+			Blank,
+			Letter,
+			Digit,
+			Slash,
+			Operator,
+			Stopchar,
+			Bracket
+		};
+
+		struct CharTable
+		{
+			CharClass classes[256];
+		};
+
+		constexpr CharTable build_char_table()
+		{
+			CharTable table{};
+			for (unsigned int c = 'a'; c <= 'z'; ++c)
+				table.classes[c] = CharClass::Letter;
+			for (unsigned int c = 'A'; c <= 'Z'; ++c)
+				table.classes[c] = CharClass::Letter;
+			for (unsigned int c = '0'; c <= '9'; ++c)
+				table.classes[c] = CharClass::Digit;
+			table.classes[static_cast<unsigned char>('_')] = CharClass::Letter;
+
+			for (char c : " \t\n\v\f\r")
+				table.classes[static_cast<unsigned char>(c)] = CharClass::Blank;
+			for (char c : "+-*=!<>&|?")
+				table.classes[static_cast<unsigned char>(c)] = CharClass::Operator;
+			for (char c : ";,:")
+				table.classes[static_cast<unsigned char>(c)] = CharClass::Stopchar;
+			for (char c : "(){}[]")
+				table.classes[static_cast<unsigned char>(c)] = CharClass::Bracket;
+			table.classes[static_cast<unsigned char>('/')] = CharClass::Slash;
+
+			/* String literals leave a trailing NUL in the loops above */
+			table.classes[0] = CharClass::Invalid;
+			return table;
+		}
+
+		constexpr CharTable char_table = build_char_table();
+
+		inline CharClass char_class(char c) { return char_table.classes[static_cast<unsigned char>(c)]; }
+
+
+		/* Trie of keywords walked while the identifier is being scanned. State 0 is the dead state. */
+		struct KeywordAutomaton
+		{
+			static constexpr size_t MAX_STATES = 32;
+
+			uint8_t next[MAX_STATES][128];
+			TokenKind accept[MAX_STATES];
+			uint8_t states;
+		};
+
+		struct KeywordEntry
+		{
+			const char* word;
+			TokenKind kind;
+		};
+
+		constexpr KeywordEntry keywords[] = {
+			{ "var", TokenKind::Var },
+			{ "const", TokenKind::Const },
+			{ "if", TokenKind::If },
+			{ "else", TokenKind::Else },
+			{ "every", TokenKind::Every }
+		};
+
+		constexpr KeywordAutomaton build_keyword_automaton()
+		{
+			KeywordAutomaton dfa{};
+			dfa.states = 2; /* 0: dead, 1: start */
+			for (const KeywordEntry& entry : keywords)
+			{
+				uint8_t state = 1;
+				for (const char* c = entry.word; *c; ++c)
+				{
+					uint8_t& target = dfa.next[state][static_cast<unsigned char>(*c)];
+					if (target == 0)
+						target = dfa.states++;
+					state = target;
+				}
+				dfa.accept[state] = entry.kind;
+			}
+			return dfa;
+		}
+
+		constexpr KeywordAutomaton keyword_automaton = build_keyword_automaton();
+
+		static_assert(keyword_automaton.states <= KeywordAutomaton::MAX_STATES, "Too many keyword states");
+		static_assert(static_cast<int>(TokenKind::Identifier) == 0, "Non accepting keyword states must map to Identifier");
+	}
+
+	static inline const char* scan_word(const char* ptr, const char* end, TokenKind& kind)
+	{
+		if (char_class(*ptr) == CharClass::Digit)
+		{
+			kind = TokenKind::Integer;
+			return scan::skipIdentifier(ptr, end);
+		}
+
+		unsigned int state = 1;
+		for (;;)
+		{
+			if (ptr == end)
+				break;
+
+			const char c = *ptr;
+			const CharClass cls = char_class(c);
+			if (cls != CharClass::Letter && cls != CharClass::Digit)
+				break;
+
+			state = keyword_automaton.next[state][static_cast<unsigned char>(c)];
+			++ptr;
+			if (state == 0)
+			{
+				/* Can no longer be a keyword, finish with the fast kernel */
+				kind = TokenKind::Identifier;
+				return scan::skipIdentifier(ptr, end);
+			}
+		}
+
+		kind = keyword_automaton.accept[state];
+		return ptr;
+	}
+
+	static inline size_t scan_operator(const char* ptr, const char* end, OperatorCode& code)
+	{
+		const bool assign = ptr + 1 < end && ptr[1] == '=';
+		const char n = ptr + 1 < end ? ptr[1] : '\0';
+		switch (ptr[0])
+		{
+			case '+':
+				code = n == '+' ? OperatorCode::Increment : assign ? OperatorCode::PlusAssign : OperatorCode::Plus;
+				return n == '+' || assign ? 2 : 1;
+			case '-':
+				code = n == '-' ? OperatorCode::Decrement : assign ? OperatorCode::MinusAssign : OperatorCode::Minus;
+				return n == '-' || assign ? 2 : 1;
+			case '*':
+				code = assign ? OperatorCode::StarAssign : OperatorCode::Star;
+				return assign ? 2 : 1;
+			case '/':
+				code = assign ? OperatorCode::SlashAssign : OperatorCode::Slash;
+				return assign ? 2 : 1;
+			case '=':
+				code = assign ? OperatorCode::Equals : OperatorCode::Assign;
+				return assign ? 2 : 1;
+			case '!':
+				code = assign ? OperatorCode::NotEquals : OperatorCode::Not;
+				return assign ? 2 : 1;
+			case '<':
+				code = assign ? OperatorCode::SmallerEquals : OperatorCode::Smaller;
+				return assign ? 2 : 1;
+			case '>':
+				code = assign ? OperatorCode::GreaterEquals : OperatorCode::Greater;
+				return assign ? 2 : 1;
+			case '&':
+				code = OperatorCode::And;
+				return n == '&' ? 2 : 0;
+			case '|':
+				code = OperatorCode::Or;
+				return n == '|' ? 2 : 0;
+			case '?':
+				code = OperatorCode::Question;
+				return 1;
+		}
+		return 0;
+	}
+
+	static inline unsigned int digit_value(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return static_cast<unsigned int>(c - '0');
+		if (c >= 'a' && c <= 'f')
+			return static_cast<unsigned int>(c - 'a' + 10);
+		if (c >= 'A' && c <= 'F')
+			return static_cast<unsigned int>(c - 'A' + 10);
+		return 16;
+	}
+
+	static inline void push(TokenStream& tokens, TokenKind kind, const char* data, const char* from, const char* to, uint32_t payload = 0)
+	{
+		tokens.push(kind, static_cast<uint32_t>(from - data), static_cast<uint32_t>(to - from), payload);
+	}
+
+	TokenKind classify(const char* begin, const char* end)
+	{
+		if (begin == end)
+			return TokenKind::Invalid;
+
+		switch (char_class(*begin))
+		{
+			case CharClass::Letter:
+			case CharClass::Digit: {
+				TokenKind kind;
+				if (scan_word(begin, end, kind) != end)
+					return TokenKind::Invalid;
+
+				FieldValue value;
+				return kind != TokenKind::Integer || parseInteger(begin, end, value) ? kind : TokenKind::Invalid;
+			}
+
+			case CharClass::Stopchar:
+				return end - begin == 1 ? TokenKind::Stopchar : TokenKind::Invalid;
+
+			case CharClass::Bracket:
+				return end - begin == 1 ? TokenKind::Bracket : TokenKind::Invalid;
+
+			case CharClass::Operator:
+			case CharClass::Slash: {
+				OperatorCode code;
+				return scan_operator(begin, end, code) == static_cast<size_t>(end - begin) ? TokenKind::Operator : TokenKind::Invalid;
+			}
+
+			default:
+				return TokenKind::Invalid;
+		}
+	}
+
+	bool parseInteger(const char* begin, const char* end, FieldValue& value)
+	{
+		if (begin == end)
+			return false;
+
+		unsigned int base = 10;
+		if (*begin == '0' && end - begin > 1)
+		{
+			++begin;
+			if (*begin == 'x' || *begin == 'X')
+			{
+				base = 16;
+				if (++begin == end)
+					return false;
+			}
+			else base = 8;
+		}
+
+		constexpr uint32_t max = static_cast<uint32_t>(std::numeric_limits<FieldValue>::max());
+		uint32_t result = 0;
+		for (; begin != end; ++begin)
+		{
+			const unsigned int digit = digit_value(*begin);
+			if (digit >= base)
+				return false;
+			if (result > (max - digit) / base)
+				return false;
+			result = result * base + digit;
+		}
+
+		value = static_cast<FieldValue>(result);
+		return true;
+	}
+
+	State tokenize(const char* data, size_t begin, size_t end, State state, TokenStream& tokens, SymbolTable* symbols)
+	{
+		const char* ptr = data + begin;
+		const char* const last = data + end;
+
+		if (state == State::BlockComment)
+		{
+			ptr = scan::findBlockCommentEnd(ptr, last);
+			if (ptr == last)
+				return State::BlockComment;
+			ptr += 2;
+		}
+
+		while (ptr < last)
+		{
+			switch (char_class(*ptr))
+			{
+				case CharClass::Blank:
+					ptr = scan::skipWhitespace(ptr, last);
+					break;
+
+				case CharClass::Letter:
+				case CharClass::Digit: {
+					TokenKind kind;
+					const char* const to = scan_word(ptr, last, kind);
+					uint32_t payload = 0;
+					if (kind == TokenKind::Integer)
+					{
+						FieldValue value;
+						if (parseInteger(ptr, to, value))
+							payload = static_cast<uint32_t>(value);
+						else kind = TokenKind::Invalid;
+					}
+					else if (kind == TokenKind::Identifier && symbols)
+						payload = symbols->intern({ ptr, static_cast<size_t>(to - ptr) });
+					push(tokens, kind, data, ptr, to, payload);
+					ptr = to;
+				} break;
+
+				case CharClass::Slash:
+					if (ptr + 1 < last && ptr[1] == '/')
+					{
+						ptr = scan::findNewline(ptr + 2, last);
+						break;
+					}
+					if (ptr + 1 < last && ptr[1] == '*')
+					{
+						ptr = scan::findBlockCommentEnd(ptr + 2, last);
+						if (ptr == last)
+							return State::BlockComment;
+						ptr += 2;
+						break;
+					}
+					/* fallthrough */
+
+				case CharClass::Operator: {
+					OperatorCode code;
+					const size_t len = scan_operator(ptr, last, code);
+					if (len > 0)
+						push(tokens, TokenKind::Operator, data, ptr, ptr + len, static_cast<uint32_t>(code));
+					else push(tokens, TokenKind::Invalid, data, ptr, ptr + 1);
+					ptr += len > 0 ? len : 1;
+				} break;
+
+				case CharClass::Stopchar:
+				case CharClass::Bracket:
+					push(tokens, char_class(*ptr) == CharClass::Stopchar ? TokenKind::Stopchar : TokenKind::Bracket, data, ptr, ptr + 1, static_cast<uint8_t>(*ptr));
+					++ptr;
+					break;
+
+				default:
+					push(tokens, TokenKind::Invalid, data, ptr, ptr + 1);
+					++ptr;
+					break;
+			}
+		}
+
+		return State::Code;
+	}
+
+	TokenStream tokenize(const char* data, size_t size, SymbolTable& symbols)
+	{
+		TokenStream tokens{ data, &symbols };
+		tokens.reserve(size / 4);
+		tokenize(data, 0, size, State::Code, tokens, &symbols);
+		return tokens;
+	}
+
+	TokenStream tokenize(const CodeReader& reader, SymbolTable& symbols)
+	{
+		TokenStream tokens{ reader.data(), &symbols };
+		tokenize(reader.data(), reader.getMinIndex(), reader.getMaxIndex(), State::Code, tokens, &symbols);
+		return tokens;
+	}
+
+	StreamLexer::StreamLexer(StreamCodeReader& reader, SymbolTable& symbols) :
+		_reader{ &reader },
+		_symbols{ &symbols },
+		_state{ State::Code },
+		_line{ 1 }
+	{}
+
+	bool StreamLexer::next(TokenStream& tokens)
+	{
+		/* The text of the previous line is reused unless a copy of those tokens still points into it */
+		if (!tokens._text || tokens._text.use_count() > 1)
+			tokens._text = std::make_shared<std::string>();
+
+		std::string& text = *tokens._text;
+		tokens.clear();
+		tokens._symbols = _symbols;
+		tokens._firstLine = _line;
+
+		const bool read = _reader->nextLine(text);
+		tokens._source = text.data();
+		if (!read)
+			return false;
+
+		_state = tokenize(text.data(), 0, text.size(), _state, tokens, _symbols);
+		if (text.back() == '\n')
+			++_line;
+		return true;
+	}
+
+	size_t StreamLexer::line() const { return _line; }
+
+
+
+	namespace
+	{
+		struct Chunk
+		{
+			size_t begin;
+			size_t end;
+			State entry;
+			State exit;
+			TokenStream tokens;
+		};
+
+		std::vector<Chunk> split_chunks(const char* data, size_t begin, size_t end, size_t count)
+		{
+			std::vector<Chunk> chunks;
+			const size_t step = (end - begin) / count;
+
+			size_t from = begin;
+			for (size_t i = 0; i < count && from < end; ++i)
+			{
+				size_t to = i + 1 == count ? end : std::max(from, begin + step * (i + 1));
+				if (to < end)
+				{
+					/* Chunks always start at the beginning of a line */
+					to = static_cast<size_t>(scan::findNewline(data + to, data + end) - data);
+					to = to < end ? to + 1 : end;
+				}
+				chunks.push_back({ from, to, State::Code, State::Code, { data, nullptr } });
+				from = to;
+			}
+			return chunks;
+		}
+	}
+
+	static TokenStream tokenize_parallel(const char* data, size_t begin, size_t end, unsigned int threads, SymbolTable& symbols)
+	{
+		if (threads == 0)
+			threads = std::max(1U, std::thread::hardware_concurrency());
+
+		const size_t maxChunks = (end - begin) / MIN_PARALLEL_CHUNK;
+		const size_t count = std::min<size_t>(threads, maxChunks);
+		if (count <= 1)
+		{
+			TokenStream tokens{ data, &symbols };
+			tokenize(data, begin, end, State::Code, tokens, &symbols);
+			return tokens;
+		}
+
+		std::vector<Chunk> chunks = split_chunks(data, begin, end, count);
+
+		/*
+		 * Every chunk but the first is lexed speculatively assuming it does not start inside a comment.
+		 * Workers leave identifiers unbound; the symbol table is only touched by this thread.
+		 */
+		std::vector<std::thread> workers;
+		workers.reserve(chunks.size());
+		for (Chunk& chunk : chunks)
+		{
+			workers.emplace_back([data, &chunk]() {
+				chunk.tokens.reserve((chunk.end - chunk.begin) / 4);
+				chunk.exit = tokenize(data, chunk.begin, chunk.end, chunk.entry, chunk.tokens, nullptr);
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+
+		/* Fix up chunks whose real entry state differs from the speculated one */
+		size_t total = chunks.front().tokens.size();
+		for (size_t i = 1; i < chunks.size(); ++i)
+		{
+			Chunk& chunk = chunks[i];
+			const State entry = chunks[i - 1].exit;
+			if (entry != chunk.entry)
+			{
+				chunk.entry = entry;
+				chunk.tokens.clear();
+				chunk.exit = tokenize(data, chunk.begin, chunk.end, chunk.entry, chunk.tokens, nullptr);
+			}
+			total += chunk.tokens.size();
+		}
+
+		TokenStream tokens{ data, &symbols };
+		tokens.reserve(total);
+		for (const Chunk& chunk : chunks)
+			tokens.append(chunk.tokens);
+		tokens.bindSymbols(symbols);
+		return tokens;
+	}
+
+	TokenStream tokenizeParallel(const char* data, size_t size, unsigned int threads, SymbolTable& symbols)
+	{
+		return tokenize_parallel(data, 0, size, threads, symbols);
+	}
+
+	TokenStream tokenizeParallel(const CodeReader& reader, unsigned int threads, SymbolTable& symbols)
+	{
+		return tokenize_parallel(reader.data(), reader.getMinIndex(), reader.getMaxIndex(), threads, symbols);
+	}
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string_view>
+#include <memory>
+
+#include "ioutils.h"
+#include "consts.h"
+#include "symbols.h"
+#include "spans.h"
+
+namespace lexer
+{
+	enum class TokenKind : uint8_t
+	{
+		Identifier,
+
+		Var,
+		Const,
+		If,
+		Else,
+		Every,
+
+		Integer,
+		Operator,
+		Stopchar,
+		Bracket,
+		Invalid
+	};
+
+	/* Payload of Operator tokens. The parser decides between the prefix, sufix and infix meaning. */
+	enum class OperatorCode : uint8_t
+	{
+		Increment,
+		Decrement,
+		Plus,
+		Minus,
+		Star,
+		Slash,
+		Not,
+		Greater,
+		Smaller,
+		GreaterEquals,
+		SmallerEquals,
+		Equals,
+		NotEquals,
+		And,
+		Or,
+		Question,
+		Assign,
+		PlusAssign,
+		MinusAssign,
+		StarAssign,
+		SlashAssign
+	};
+
+	/*
+	 * Payload depends on the kind: Symbol for Identifier, value for Integer, OperatorCode for Operator
+	 * and the character itself for Stopchar and Bracket.
+	 */
+	struct Token
+	{
+		TokenKind kind;
+		uint32_t offset;
+		uint32_t length;
+		uint32_t payload;
+
+		inline bool operator== (const Token& t) const { return kind == t.kind && offset == t.offset && length == t.length && payload == t.payload; }
+		inline bool operator!= (const Token& t) const { return !operator==(t); }
+	};
+
+	class StreamLexer;
+
+	/* Tokens of a source stored as parallel arrays */
+	class TokenStream
+	{
+		friend class StreamLexer;
+
+	private:
+		const char* _source;
+		const SymbolTable* _symbols;
+
+		/* Text owned by the stream when nothing else keeps the source, shared by its copies */
+		std::shared_ptr<std::string> _text;
+
+		/* Line of the first character of source */
+		size_t _firstLine;
+
+		std::vector<TokenKind> _kinds;
+		std::vector<uint32_t> _offsets;
+		std::vector<uint32_t> _lengths;
+		std::vector<uint32_t> _payloads;
+
+	public:
+		TokenStream();
+		TokenStream(const char* source, const SymbolTable* symbols);
+		TokenStream(const TokenStream&) = default;
+		TokenStream(TokenStream&&) noexcept = default;
+		~TokenStream() = default;
+
+		TokenStream& operator= (const TokenStream&) = default;
+		TokenStream& operator= (TokenStream&&) noexcept = default;
+
+		size_t size() const;
+		bool empty() const;
+
+		void reserve(size_t capacity);
+		void clear();
+
+		void push(TokenKind kind, uint32_t offset, uint32_t length, uint32_t payload = 0);
+		void append(const TokenStream& tokens);
+
+		inline TokenKind kind(size_t index) const { return _kinds[index]; }
+		inline uint32_t offset(size_t index) const { return _offsets[index]; }
+		inline uint32_t length(size_t index) const { return _lengths[index]; }
+		inline SourceSpan span(size_t index) const { return { _offsets[index], _lengths[index] }; }
+		inline uint32_t payload(size_t index) const { return _payloads[index]; }
+
+		inline std::string_view text(size_t index) const { return { _source + _offsets[index], _lengths[index] }; }
+
+		inline bool isOperator(size_t index, OperatorCode code) const { return _kinds[index] == TokenKind::Operator && _payloads[index] == static_cast<uint32_t>(code); }
+		inline bool isChar(size_t index, char c) const
+		{
+			return (_kinds[index] == TokenKind::Stopchar || _kinds[index] == TokenKind::Bracket) && _payloads[index] == static_cast<uint32_t>(c);
+		}
+
+		Token operator[] (size_t index) const;
+
+		const char* source() const;
+		const SymbolTable* symbols() const;
+		size_t firstLine() const;
+
+		/* Interns the identifiers lexed without a symbol table */
+		void bindSymbols(SymbolTable& symbols);
+
+		bool operator== (const TokenStream& tokens) const;
+		bool operator!= (const TokenStream& tokens) const;
+	};
+
+	/* Kind of the single token spelled by [begin, end), or Invalid if the text is not exactly one token */
+	TokenKind classify(const char* begin, const char* end);
+
+	inline bool isKeyword(TokenKind kind) { return kind >= TokenKind::Var && kind <= TokenKind::Every; }
+
+	/* Lexer state at a line boundary. Only block comments can span several lines. */
+	enum class State : uint8_t
+	{
+		Code,
+		BlockComment
+	};
+
+	/* Decimal "0|[1-9][0-9]*", octal "0[0-7]+" or hex "0[xX][0-9a-fA-F]+", up to INT32_MAX */
+	bool parseInteger(const char* begin, const char* end, FieldValue& value);
+
+	/* Identifiers are interned into symbols if given; otherwise their payload is left as INVALID_SYMBOL */
+	State tokenize(const char* data, size_t begin, size_t end, State state, TokenStream& tokens, SymbolTable* symbols);
+
+	TokenStream tokenize(const char* data, size_t size, SymbolTable& symbols = SymbolTable::current());
+	TokenStream tokenize(const CodeReader& reader, SymbolTable& symbols = SymbolTable::current());
+
+
+	/* Splits the source at newline boundaries and lexes the chunks concurrently. threads == 0 uses every core. */
+	TokenStream tokenizeParallel(const char* data, size_t size, unsigned int threads = 0, SymbolTable& symbols = SymbolTable::current());
+	TokenStream tokenizeParallel(const CodeReader& reader, unsigned int threads = 0, SymbolTable& symbols = SymbolTable::current());
+
+	constexpr size_t MIN_PARALLEL_CHUNK = 256 * 1024;
+
+	/*
+	 * Lexes a StreamCodeReader one line at a time, as soon as the reader delivers it. Each line is copied out of the
+	 * reader's window into the TokenStream it is lexed into, which owns it, so the input is dropped as the reader
+	 * moves on and memory is bounded by the window and the longest line, not by the length of the stream.
+	 */
+	class StreamLexer
+	{
+	private:
+		StreamCodeReader* _reader;
+		SymbolTable* _symbols;
+		State _state;
+		size_t _line;
+
+	public:
+		StreamLexer(StreamCodeReader& reader, SymbolTable& symbols = SymbolTable::current());
+
+		/*
+		 * Replaces tokens with the tokens of the next line, which may be none. False at the end of the stream.
+		 * Throws WindowExceeded if the line is longer than the reader's lookahead.
+		 */
+		bool next(TokenStream& tokens);
+
+		/* Line next() lexes next */
+		size_t line() const;
+	};
+}
@@ -1,9 +1,41 @@
 #include <iostream>
+#include <fstream>
+#include <string>
 
 #include "lang_elements.h"
+#include "bench.h"
 
 
 int main(int argc, char** argv)
 {
+	const std::string command = argc > 1 ? argv[1] : "";
+	if (command == "--bench-nodes")
+	{
+		bench::nodeAllocations(std::cout);
+		return 0;
+	}
+	if (command == "--bench-statements")
+	{
+		bench::statementParsing(std::cout);
+		return 0;
+	}
+	if (command == "--bench-literals")
+	{
+		bench::literalRecognition(std::cout);
+		return 0;
+	}
+	if (command == "--check-stream-memory")
+		return bench::streamMemory(std::cout) ? 0 : 1;
+	if (command == "--check-statements" && argc > 2)
+	{
+		std::ifstream corpus{ argv[2] };
+		if (!corpus)
+		{
+			std::cerr << "Cannot open " << argv[2] << std::endl;
+			return 2;
+		}
+		return bench::statementCorpus(corpus, std::cout) ? 0 : 1;
+	}
+
 	return 0;
 }
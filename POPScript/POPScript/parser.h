@@ -1,14 +1,22 @@
 #pragma once
 
-#include <list>
-#include <sstream>
+#include <string>
 
 #include "parser_elements.h"
 #include "ioutils.h"
+#include "lexer.h"
 
 namespace parser::statement
 {
-	CloneableAllocator<Statement> parse(const CodeFragmentList& list);
+	/*
+	 * maxNesting is the deepest nesting of groups, unary prefixes and pending operators a statement may have
+	 * before parse fails. It is passed per call, so concurrent parses never share a limit.
+	 */
+	CloneableAllocator<Statement> parse(const CodeFragmentList& list, size_t maxNesting = STATEMENT_NESTING_LIMIT);
+	CloneableAllocator<Statement> parse(const CodeFragmentSpan& span, size_t maxNesting = STATEMENT_NESTING_LIMIT);
+
+	/* Parses the statement spelled by tokens [begin, end) */
+	CloneableAllocator<Statement> parse(const lexer::TokenStream& tokens, size_t begin, size_t end, size_t maxNesting = STATEMENT_NESTING_LIMIT);
 }
 
 namespace parser
@@ -18,12 +26,26 @@ namespace parser
 	public:
 		class Queue
 		{
+		public:
+			/*
+			 * Most words the grammar buffers before it can decide what it is reading: a declaration
+			 * decides at its third word ('var' name '=' or ','), an every loop at its third ('every'
+			 * turns offset), plus the word being decoded.
+			 */
+			static constexpr size_t MAX_LOOKAHEAD = 4;
+
+			static constexpr size_t CAPACITY = 16;
+			static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "Queue capacity must be a power of two");
+			static_assert(MAX_LOOKAHEAD <= CAPACITY, "Queue capacity must hold the grammar lookahead");
+
 		private:
-			std::list<CloneableAllocator<CodeFragment>> _q;
+			CloneableAllocator<CodeFragment> _q[CAPACITY];
+			size_t _head;
+			size_t _size;
 			CloneableAllocator<CodeFragment> _last;
 
 		public:
-			Queue() = default;
+			Queue();
 			Queue(const CodeFragment& last);
 			~Queue() = default;
 
@@ -32,26 +54,31 @@ namespace parser
 
 			const CodeFragment& front() const;
 
-			void push(const CodeFragment& frag);
+			/* Fragments enter by move only, so the queue never clones them */
+			void push(CloneableAllocator<CodeFragment>&& frag);
 
 			bool pop();
+			bool pop(CloneableAllocator<CodeFragment>& dst);
 
 			void setLast(const CodeFragment& frag);
 			void eraseLast();
 			bool hasLast() const;
 			const CodeFragment& getLast() const;
 
-			void push_ret(const CodeFragment& frag, CloneableAllocator<CodeFragment>& dst);
+			void push_ret(CloneableAllocator<CodeFragment>&& frag, CloneableAllocator<CodeFragment>& dst);
 
-			inline operator bool() const { return !_q.empty(); }
-			inline bool operator! () const { return _q.empty(); }
+			inline operator bool() const { return _size > 0; }
+			inline bool operator! () const { return _size == 0; }
+
+		private:
+			inline size_t slot(size_t offset) const { return (_head + offset) & (CAPACITY - 1); }
 		};
 
 		class Builder
 		{
 		private:
 			Queue* _q;
-			std::stringstream _ss;
+			std::string _text;
 			bool _canFinish;
 			bool _finishedEnabled;
 
@@ -82,29 +109,29 @@ namespace parser
 			inline operator bool() const { return !empty(); }
 			inline bool operator! () const { return empty(); }
 
-			inline Builder& operator<< (const uint8_t value) { _ss << value; return *this; }
-			inline Builder& operator<< (const uint16_t value) { _ss << value; return *this; }
-			inline Builder& operator<< (const uint32_t value) { _ss << value; return *this; }
-			inline Builder& operator<< (const uint64_t value) { _ss << value; return *this; }
+			inline Builder& operator<< (const uint8_t value) { _text.push_back(static_cast<char>(value)); return *this; }
+			inline Builder& operator<< (const uint16_t value) { _text.append(std::to_string(value)); return *this; }
+			inline Builder& operator<< (const uint32_t value) { _text.append(std::to_string(value)); return *this; }
+			inline Builder& operator<< (const uint64_t value) { _text.append(std::to_string(value)); return *this; }
 
-			inline Builder& operator<< (const int8_t value) { _ss << value; return *this; }
-			inline Builder& operator<< (const int16_t value) { _ss << value; return *this; }
-			inline Builder& operator<< (const int32_t value) { _ss << value; return *this; }
-			inline Builder& operator<< (const int64_t value) { _ss << value; return *this; }
+			inline Builder& operator<< (const int8_t value) { _text.push_back(static_cast<char>(value)); return *this; }
+			inline Builder& operator<< (const int16_t value) { _text.append(std::to_string(value)); return *this; }
+			inline Builder& operator<< (const int32_t value) { _text.append(std::to_string(value)); return *this; }
+			inline Builder& operator<< (const int64_t value) { _text.append(std::to_string(value)); return *this; }
 
-			inline Builder& operator<< (const float value) { _ss << value; return *this; }
-			inline Builder& operator<< (const double value) { _ss << value; return *this; }
+			Builder& operator<< (const float value);
+			Builder& operator<< (const double value);
 
-			inline Builder& operator<< (const char value) { _ss << value; return *this; }
+			inline Builder& operator<< (const char value) { _text.push_back(value); return *this; }
 
-			inline Builder& operator<< (const bool value) { _ss << value; return *this; }
+			inline Builder& operator<< (const bool value) { _text.push_back(value ? '1' : '0'); return *this; }
 
-			inline Builder& operator<< (const std::string& value) { _ss << value; return *this; }
+			inline Builder& operator<< (const std::string& value) { _text.append(value); return *this; }
 
-			inline Builder& operator<< (const CodeFragment& value) { _ss << value; return *this; }
+			inline Builder& operator<< (const CodeFragment& value) { _text.append(value.toString()); return *this; }
 		};
 	};
 }
 
-parser::CodeParser::Queue& operator<< (parser::CodeParser::Queue& q, const CodeFragment& frag);
+parser::CodeParser::Queue& operator<< (parser::CodeParser::Queue& q, CloneableAllocator<CodeFragment>&& frag);
 parser::CodeParser::Queue& operator>> (parser::CodeParser::Queue& q, CloneableAllocator<CodeFragment>& frag);
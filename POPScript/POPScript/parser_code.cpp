@@ -1,29 +1,60 @@
 #include "parser.h"
 
-#include <sstream>
+#include <cstdio>
+
+#include "lexer.h"
 
 namespace parser
 {
+	CodeParser::Queue::Queue() :
+		_q{},
+		_head{ 0 },
+		_size{ 0 },
+		_last{}
+	{}
 	CodeParser::Queue::Queue(const CodeFragment& last) :
 		_q{},
+		_head{ 0 },
+		_size{ 0 },
 		_last{ last }
 	{}
 
-	size_t CodeParser::Queue::size() const { return _q.size(); }
-	bool CodeParser::Queue::empty() const { return _q.empty(); }
+	size_t CodeParser::Queue::size() const { return _size; }
+	bool CodeParser::Queue::empty() const { return _size == 0; }
 
-	const CodeFragment& CodeParser::Queue::front() const { return _q.front(); }
+	const CodeFragment& CodeParser::Queue::front() const
+	{
+		if (_size == 0)
+			throw IllegalState{ "Empty queue" };
+		return _q[_head];
+	}
 
-	void CodeParser::Queue::push(const CodeFragment& frag) { _q.emplace_back(frag); }
+	void CodeParser::Queue::push(CloneableAllocator<CodeFragment>&& frag)
+	{
+		if (_size == CAPACITY)
+			throw IllegalState{ "Queue lookahead capacity exceeded" };
+		_q[slot(_size++)] = std::move(frag);
+	}
 
 	bool CodeParser::Queue::pop()
 	{
-		if (!_q.empty())
-		{
-			_q.pop_front();
-			return true;
-		}
-		return false;
+		if (_size == 0)
+			return false;
+
+		_q[_head] = nullptr;
+		_head = slot(1);
+		--_size;
+		return true;
+	}
+	bool CodeParser::Queue::pop(CloneableAllocator<CodeFragment>& dst)
+	{
+		if (_size == 0)
+			return false;
+
+		dst = std::move(_q[_head]);
+		_head = slot(1);
+		--_size;
+		return true;
 	}
 
 	void CodeParser::Queue::setLast(const CodeFragment& frag) { _last = frag; }
@@ -31,31 +62,27 @@ namespace parser
 	bool CodeParser::Queue::hasLast() const { return _last; }
 	const CodeFragment& CodeParser::Queue::getLast() const { return _last; }
 
-	void CodeParser::Queue::push_ret(const CodeFragment& frag, CloneableAllocator<CodeFragment>& dst)
+	void CodeParser::Queue::push_ret(CloneableAllocator<CodeFragment>&& frag, CloneableAllocator<CodeFragment>& dst)
 	{
-		if (_q.empty())
-			dst = frag;
+		if (_size == 0)
+			dst = std::move(frag);
 		else
 		{
-			dst = _q.front();
-			_q.pop_front();
-			_q.emplace_back(frag);
+			dst = std::move(_q[_head]);
+			_head = slot(1);
+			_q[slot(_size - 1)] = std::move(frag);
 		}
 	}
 }
 
-parser::CodeParser::Queue& operator<< (parser::CodeParser::Queue& q, const CodeFragment& frag)
+parser::CodeParser::Queue& operator<< (parser::CodeParser::Queue& q, CloneableAllocator<CodeFragment>&& frag)
 {
-	q.push(frag);
+	q.push(std::move(frag));
 	return q;
 }
 parser::CodeParser::Queue& operator>> (parser::CodeParser::Queue& q, CloneableAllocator<CodeFragment>& frag)
 {
-	if (q)
-	{
-		frag = q.front();
-		q.pop();
-	}
+	q.pop(frag);
 	return q;
 }
 
@@ -72,16 +99,16 @@ namespace parser
 {
 	CodeParser::Builder::Builder(Queue& queue, bool canFinish) :
 		_q{ &queue },
-		_ss{},
+		_text{},
 		_canFinish{ canFinish },
 		_finishedEnabled{ true }
 	{}
 	CodeParser::Builder::~Builder() {}
 
-	size_t CodeParser::Builder::size() const { return _ss.str().size(); }
-	bool CodeParser::Builder::empty() const { return _ss.str().empty(); }
+	size_t CodeParser::Builder::size() const { return _text.size(); }
+	bool CodeParser::Builder::empty() const { return _text.empty(); }
 
-	void CodeParser::Builder::clear() { _ss.str(""); }
+	void CodeParser::Builder::clear() { _text.clear(); }
 
 	void CodeParser::Builder::enableFinish() { _finishedEnabled = true; }
 	void CodeParser::Builder::disableFinish() { _finishedEnabled = false; }
@@ -94,7 +121,7 @@ namespace parser
 			return !_q->empty();
 		CloneableAllocator<CodeFragment> frag = decode();
 		clear();
-		_q->push(frag);
+		_q->push(std::move(frag));
 		return true;
 	}
 
@@ -104,19 +131,28 @@ namespace parser
 			throw IllegalState{};
 
 
-		std::string text = _ss.str();
-		if (text == "var") return Command::Var;
-		if (text == "const") return Command::Const;
-		if (text == "if") return Command::If;
-		if (text == "else") return Command::Else;
-		if (text == "every") return Command::Every;
-		
-		if (TypeConstant::isValid(text))
-			return TypeConstant::parse(text);
+		const lexer::TokenKind kind = lexer::classify(_text.data(), _text.data() + _text.size());
+		if (lexer::isKeyword(kind))
+			return *Command::find(_text);
+
+		/* Malformed words such as 12ab classify as Invalid and are reported by the Identifier fallback */
+		if (kind == lexer::TokenKind::Integer)
+			return LiteralInteger::parse(_text);
 
-		if (LiteralInteger::isValid(text))
-			return LiteralInteger::parse(text);
+		CodeValue code;
+		if (DataType::findTypeFromValueName(_text, code))
+			return TypeConstant::parse(code);
 
-		return Identifier{ text };
+		return Identifier{ _text };
+	}
+
+	/* Same formatting as the default std::ostream floating point output */
+	CodeParser::Builder& CodeParser::Builder::operator<< (const float value) { return operator<<(static_cast<double>(value)); }
+	CodeParser::Builder& CodeParser::Builder::operator<< (const double value)
+	{
+		char buffer[32];
+		const int len = std::snprintf(buffer, sizeof(buffer), "%g", value);
+		_text.append(buffer, len > 0 ? static_cast<size_t>(len) : 0);
+		return *this;
 	}
 }
@@ -2,6 +2,10 @@
 
 #include <cstdarg>
 #include <sstream>
+#include <iterator>
+
+#include "perfect_hash.h"
+#include "lexer.h"
 
 
 
@@ -14,6 +18,7 @@ static inline std::string ident(const size_t identation)
 
 
 bool CodeFragment::is(CodeFragmentType type) const { return getCodeFragmentType() == type; }
+bool CodeFragment::isAny(CodeFragmentKinds kinds) const { return (codeFragmentKind(getCodeFragmentType()) & kinds) != 0; }
 
 std::ostream& operator<< (std::ostream& os, const CodeFragment& cf) { return os << cf.toString(); }
 
@@ -22,43 +27,82 @@ std::ostream& operator<< (std::ostream& os, const CodeFragment& cf) { return os
 
 bool Statement::isStatement() const { return true; }
 
+static inline size_t structural_hash(CodeFragmentType type, size_t value) { return hash_combine(static_cast<size_t>(type), value); }
+
+static inline size_t structural_hash(std::string_view name) { return structural_hash(CodeFragmentType::Identifier, std::hash<std::string_view>{}(name)); }
+
+static inline size_t structural_hash(Instruction::Type type) { return structural_hash(CodeFragmentType::Instruction, static_cast<size_t>(type)); }
+
+template<class _Ty>
+static inline size_t structural_hash(const CloneableAllocator<_Ty>& node) { return node ? static_cast<const _Ty&>(node).structuralHash() : 0; }
+
+template<class _Ty>
+static size_t structural_hash(size_t seed, const CloneableVector<_Ty>& nodes)
+{
+	for (const CloneableAllocator<_Ty>& node : nodes.stdvector())
+		seed = hash_combine(seed, structural_hash(node));
+	return seed;
+}
+
 
 
 
 
 Identifier::Identifier(const std::string& identifier) :
 	Statement{},
-	_id{ identifier }
+	_id{ INVALID_SYMBOL },
+	_table{ nullptr }
 {
 	if (!isValid(identifier))
 		throw InvalidIdentifier{};
+
+	SymbolTable& table = SymbolTable::current();
+	_id = table.intern(identifier);
+	_table = &table;
+	setStructuralHash(structural_hash(getName()));
+}
+Identifier::Identifier(Symbol symbol, const SymbolTable& table) :
+	Statement{},
+	_id{ symbol },
+	_table{ &table }
+{
+	setStructuralHash(structural_hash(getName()));
 }
 Identifier::Identifier(const Identifier& id) :
 	Statement{ id },
-	_id{ id._id }
+	_id{ id._id },
+	_table{ id._table }
 {}
 Identifier::Identifier(Identifier&& id) noexcept :
 	Statement{ std::move(id) },
-	_id{ std::move(id._id) }
+	_id{ id._id },
+	_table{ id._table }
 {}
 Identifier::~Identifier() {}
 
 Identifier& Identifier::operator= (const Identifier& id)
 {
+	Statement::operator=(id);
 	_id = id._id;
+	_table = id._table;
 	return *this;
 }
 Identifier& Identifier::operator= (Identifier&& id) noexcept
 {
-	_id = std::move(id._id);
+	Statement::operator=(std::move(id));
+	_id = id._id;
+	_table = id._table;
 	return *this;
 }
 
+Symbol Identifier::getSymbol() const { return _id; }
+std::string_view Identifier::getName() const { return _table->name(_id); }
+
 CodeFragmentType Identifier::getCodeFragmentType() const { return CodeFragmentType::Identifier; }
 
-std::string Identifier::toString(size_t identation) const { return _id; }
+std::string Identifier::toString(size_t identation) const { return std::string{ getName() }; }
 
-void* Identifier::clone() const { return new Identifier{ _id }; }
+void* Identifier::clone() const { return new Identifier{ *this }; }
 
 bool Identifier::operator== (const CodeFragment& c) const
 {
@@ -66,12 +110,25 @@ bool Identifier::operator== (const CodeFragment& c) const
 		return operator==(reinterpret_cast<const Identifier&>(c));
 	return false;
 }
-bool Identifier::operator== (const Identifier& id) const { return _id == id._id; }
-bool Identifier::operator!= (const Identifier& id) const { return _id != id._id; }
+bool Identifier::operator== (const Identifier& id) const
+{
+	/* Symbols from different tables are only comparable by name */
+	return _table == id._table ? _id == id._id : getName() == id.getName();
+}
+bool Identifier::operator!= (const Identifier& id) const { return !operator==(id); }
 
-const std::regex Identifier::_pattern{ "[_a-zA-Z][_a-zA-Z0-9]*" };
+static inline bool is_identifier_char(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; }
 
-bool Identifier::isValid(const std::string& str) { return std::regex_search(str, _pattern); }
+bool Identifier::isValid(const std::string& str) { return isValid(str.data(), str.data() + str.size()); }
+bool Identifier::isValid(const char* begin, const char* end)
+{
+	if (begin == end || (*begin >= '0' && *begin <= '9') || !is_identifier_char(*begin))
+		return false;
+	for (++begin; begin != end; ++begin)
+		if (!is_identifier_char(*begin))
+			return false;
+	return true;
+}
 
 
 
@@ -81,7 +138,9 @@ bool Identifier::isValid(const std::string& str) { return std::regex_search(str,
 LiteralInteger::LiteralInteger(FieldValue value) :
 	Statement{},
 	_value{ value }
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::LiteralInteger, static_cast<size_t>(value)));
+}
 LiteralInteger::LiteralInteger(const LiteralInteger& lit) :
 	Statement{ lit },
 	_value{ lit._value }
@@ -94,11 +153,13 @@ LiteralInteger::~LiteralInteger() {}
 
 LiteralInteger& LiteralInteger::operator= (const LiteralInteger& lit)
 {
+	Statement::operator=(lit);
 	_value = lit._value;
 	return *this;
 }
 LiteralInteger& LiteralInteger::operator= (LiteralInteger&& lit) noexcept
 {
+	Statement::operator=(std::move(lit));
 	_value = std::move(lit._value);
 	return *this;
 }
@@ -109,7 +170,7 @@ CodeFragmentType LiteralInteger::getCodeFragmentType() const { return CodeFragme
 
 std::string LiteralInteger::toString(size_t identation) const { return std::to_string(_value); }
 
-void* LiteralInteger::clone() const { return new LiteralInteger{ _value }; }
+void* LiteralInteger::clone() const { return new LiteralInteger{ *this }; }
 
 bool LiteralInteger::operator== (const CodeFragment& c) const
 {
@@ -120,21 +181,20 @@ bool LiteralInteger::operator== (const CodeFragment& c) const
 bool LiteralInteger::operator== (const LiteralInteger& lit) const { return _value == lit._value; }
 bool LiteralInteger::operator!= (const LiteralInteger& lit) const { return _value != lit._value; }
 
-const std::regex LiteralInteger::_pattern{ "(0|0[xX])?[0-9]+" };
+bool LiteralInteger::tryParse(const char* begin, const char* end, FieldValue& value) { return lexer::parseInteger(begin, end, value); }
 
-static int find_integer_base(const std::string& str)
+LiteralInteger LiteralInteger::parse(const std::string& str)
 {
-	if (str.size() <= 1 || str[0] != '0')
-		return 10;
-	const char& c = str[1];
-	return c == 'x' || c == 'X' ? 16 : 8;
+	FieldValue value;
+	if (!tryParse(str.data(), str.data() + str.size(), value))
+		throw InvalidLiteral{};
+	return value;
 }
-
-LiteralInteger LiteralInteger::parse(const std::string& str)
+bool LiteralInteger::isValid(const std::string& str)
 {
-	return std::stol(str, nullptr, find_integer_base(str));
+	FieldValue value;
+	return tryParse(str.data(), str.data() + str.size(), value);
 }
-bool LiteralInteger::isValid(const std::string& str) { return std::regex_search(str, _pattern); }
 
 
 
@@ -147,7 +207,9 @@ TypeConstant::TypeConstant(CodeValue value) :
 	Statement{},
 	_value{ value },
 	_type{ DataType::findTypeFromValue(value) }
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::TypeConstant, value));
+}
 TypeConstant::TypeConstant(const TypeConstant& tc) :
 	Statement{ tc },
 	_value{ tc._value },
@@ -162,12 +224,14 @@ TypeConstant::~TypeConstant() {}
 
 TypeConstant& TypeConstant::operator= (const TypeConstant& tc)
 {
+	Statement::operator=(tc);
 	_type = tc._type;
 	_value = tc._value;
 	return *this;
 }
 TypeConstant& TypeConstant::operator= (TypeConstant&& tc) noexcept
 {
+	Statement::operator=(std::move(tc));
 	_type = std::move(tc._type);
 	_value = std::move(tc._value);
 	return *this;
@@ -203,7 +267,9 @@ bool TypeConstant::isValid(CodeValue code) { return DataType::findTypeFromValue(
 
 TypeConstant TypeConstant::parse(const std::string& str)
 {
-	return { DataType::findTypeFromValueName(str).getIdentifierValue(str) };
+	CodeValue code = 0;
+	DataType::findTypeFromValueName(str, code);
+	return { code };
 }
 TypeConstant TypeConstant::parse(CodeValue code)
 {
@@ -221,7 +287,9 @@ TypeConstant TypeConstant::parse(CodeValue code)
 Stopchar::Stopchar(char symbol) :
 	CodeFragment{},
 	_symbol{ symbol }
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::Stopchar, static_cast<size_t>(symbol)));
+}
 Stopchar::Stopchar(const Stopchar& sc) :
 	CodeFragment{ sc },
 	_symbol{ sc._symbol }
@@ -230,6 +298,7 @@ Stopchar::~Stopchar() {}
 
 Stopchar& Stopchar::operator= (const Stopchar& sc)
 {
+	CodeFragment::operator=(sc);
 	_symbol = sc._symbol;
 	return *this;
 }
@@ -324,7 +393,9 @@ bool ArgumentList::operator!= (const ArgumentList& al) const { return _args != a
 FunctionArguments::FunctionArguments() :
 	Statement{},
 	ArgumentList{}
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::FunctionArguments, 0));
+}
 FunctionArguments::FunctionArguments(const FunctionArguments& a) :
 	Statement{ a },
 	ArgumentList{ a }
@@ -337,15 +408,23 @@ FunctionArguments::~FunctionArguments() {}
 
 FunctionArguments& FunctionArguments::operator= (const FunctionArguments& a)
 {
+	Statement::operator=(a);
 	ArgumentList::operator=(a);
 	return *this;
 }
 FunctionArguments& FunctionArguments::operator= (FunctionArguments&& a) noexcept
 {
+	Statement::operator=(std::move(a));
 	ArgumentList::operator=(std::move(a));
 	return *this;
 }
 
+void FunctionArguments::addArgument(const Statement& arg)
+{
+	ArgumentList::addArgument(arg);
+	setStructuralHash(hash_combine(structuralHash(), arg.structuralHash()));
+}
+
 CodeFragmentType FunctionArguments::getCodeFragmentType() const { return CodeFragmentType::FunctionArguments; }
 
 std::string FunctionArguments::toString(size_t identation) const { return ArgumentList::toString(); }
@@ -358,8 +437,8 @@ bool FunctionArguments::operator== (const CodeFragment& c) const
 		return operator==(reinterpret_cast<const FunctionArguments&>(c));
 	return false;
 }
-bool FunctionArguments::operator== (const FunctionArguments& a) const { return ArgumentList::operator==(a); }
-bool FunctionArguments::operator!= (const FunctionArguments& a) const { return ArgumentList::operator!=(a); }
+bool FunctionArguments::operator== (const FunctionArguments& a) const { return structuralHash() == a.structuralHash() && ArgumentList::operator==(a); }
+bool FunctionArguments::operator!= (const FunctionArguments& a) const { return structuralHash() != a.structuralHash() || ArgumentList::operator!=(a); }
 
 
 
@@ -372,7 +451,9 @@ bool FunctionArguments::operator!= (const FunctionArguments& a) const { return A
 CommandArguments::CommandArguments() :
 	CodeFragment{},
 	ArgumentList{}
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::CommandArguments, 0));
+}
 CommandArguments::CommandArguments(const CommandArguments& a) :
 	CodeFragment{ a },
 	ArgumentList{ a }
@@ -385,15 +466,23 @@ CommandArguments::~CommandArguments() {}
 
 CommandArguments& CommandArguments::operator= (const CommandArguments& a)
 {
+	CodeFragment::operator=(a);
 	ArgumentList::operator=(a);
 	return *this;
 }
 CommandArguments& CommandArguments::operator= (CommandArguments&& a) noexcept
 {
+	CodeFragment::operator=(std::move(a));
 	ArgumentList::operator=(std::move(a));
 	return *this;
 }
 
+void CommandArguments::addArgument(const Statement& arg)
+{
+	ArgumentList::addArgument(arg);
+	setStructuralHash(hash_combine(structuralHash(), arg.structuralHash()));
+}
+
 CodeFragmentType CommandArguments::getCodeFragmentType() const { return CodeFragmentType::CommandArguments; }
 
 bool CommandArguments::isStatement() const { return false; }
@@ -408,92 +497,142 @@ bool CommandArguments::operator== (const CodeFragment& c) const
 		return operator==(reinterpret_cast<const CommandArguments&>(c));
 	return false;
 }
-bool CommandArguments::operator== (const CommandArguments& a) const { return ArgumentList::operator==(a); }
-bool CommandArguments::operator!= (const CommandArguments& a) const { return ArgumentList::operator!=(a); }
+bool CommandArguments::operator== (const CommandArguments& a) const { return structuralHash() == a.structuralHash() && ArgumentList::operator==(a); }
+bool CommandArguments::operator!= (const CommandArguments& a) const { return structuralHash() != a.structuralHash() || ArgumentList::operator!=(a); }
+
+
+
+
+
+
+
 
 
 
+struct OperatorInfo
+{
+	const char* symbol;
+	Operator::Type type;
+	uint8_t priority;
+	bool rightToLeft;
+	bool conditional;
+};
+
+/* Indexed by Operator::Id */
+static constexpr OperatorInfo operatorInfo[Operator::COUNT] = {
+	{ "++", Operator::Type::Unary, 0, false, false },
+	{ "--", Operator::Type::Unary, 0, false, false },
+
+	{ "++", Operator::Type::Unary, 1, true, false },
+	{ "--", Operator::Type::Unary, 1, true, false },
+	{ "-", Operator::Type::Unary, 1, true, false },
+	{ "!", Operator::Type::Unary, 1, true, false },
 
+	{ "*", Operator::Type::Binary, 2, false, false },
+	{ "/", Operator::Type::Binary, 2, false, false },
 
+	{ "+", Operator::Type::Binary, 3, false, false },
+	{ "-", Operator::Type::Binary, 3, false, false },
 
+	{ ">", Operator::Type::Binary, 4, false, true },
+	{ "<", Operator::Type::Binary, 4, false, true },
+	{ ">=", Operator::Type::Binary, 4, false, true },
+	{ "<=", Operator::Type::Binary, 4, false, true },
 
+	{ "==", Operator::Type::Binary, 5, false, true },
+	{ "!=", Operator::Type::Binary, 5, false, true },
 
+	{ "&&", Operator::Type::Binary, 6, false, false },
+	{ "||", Operator::Type::Binary, 6, false, false },
 
+	{ "?:", Operator::Type::Ternary, 7, false, false },
 
-Operator::Operator(const std::string& symbol, const Type type, unsigned int priority, bool rightToLeft, bool conditional) :
+	{ "=", Operator::Type::Assignment, 8, true, false },
+	{ "+=", Operator::Type::Assignment, 8, true, false },
+	{ "-=", Operator::Type::Assignment, 8, true, false },
+	{ "*=", Operator::Type::Assignment, 8, true, false },
+	{ "/=", Operator::Type::Assignment, 8, true, false }
+};
+
+struct OperatorPriorities
+{
+	int8_t compare[Operator::COUNT][Operator::COUNT];
+};
+
+static constexpr OperatorPriorities buildOperatorPriorities()
+{
+	OperatorPriorities table{};
+	for (size_t i = 0; i < Operator::COUNT; ++i)
+	{
+		for (size_t j = 0; j < Operator::COUNT; ++j)
+		{
+			const OperatorInfo& op = operatorInfo[i];
+			const OperatorInfo& other = operatorInfo[j];
+			if (op.priority == other.priority)
+				table.compare[i][j] = op.rightToLeft || other.rightToLeft ? -1 : 0;
+			else table.compare[i][j] = op.priority < other.priority ? 1 : -1;
+		}
+	}
+	return table;
+}
+
+/* comparePriority of every pair of operators */
+static constexpr OperatorPriorities operatorPriorities = buildOperatorPriorities();
+
+static inline const OperatorInfo& info(Operator::Id id) { return operatorInfo[static_cast<size_t>(id)]; }
+
+Operator::Operator(Id id) :
 	CodeFragment{},
-	_id{},
-	_symbol{ symbol },
-	_type{ type },
-	_priority{ priority },
-	_rightToLeft{ rightToLeft },
-	_conditional{ conditional }
+	_id{ id }
 {
-	uint8_t id_gen = 0;
-	_id = id_gen++;
+	setStructuralHash(structural_hash(CodeFragmentType::Operator, static_cast<size_t>(id)));
 }
 Operator::Operator(const Operator& op) :
 	CodeFragment{ op },
-	_id{ op._id },
-	_symbol{ op._symbol },
-	_type{ op._type },
-	_priority{ op._priority },
-	_rightToLeft{ op._rightToLeft },
-	_conditional{ op._conditional }
+	_id{ op._id }
 {}
 Operator::Operator(Operator&& op) noexcept :
 	CodeFragment{ std::move(op) },
-	_id{ std::move(op._id) },
-	_symbol{ std::move(op._symbol) },
-	_type{ std::move(op._type) },
-	_priority{ std::move(op._priority) },
-	_rightToLeft{ std::move(op._rightToLeft) },
-	_conditional{ std::move(op._conditional) }
+	_id{ op._id }
 {}
 Operator::~Operator() {}
 
 Operator& Operator::operator= (const Operator& op)
 {
+	CodeFragment::operator=(op);
 	_id = op._id;
-	_symbol = op._symbol;
-	_type = op._type;
-	_priority = op._priority;
-	_rightToLeft = op._rightToLeft;
-	_conditional = op._conditional;
 	return *this;
 }
 Operator& Operator::operator= (Operator&& op) noexcept
 {
-	_id = std::move(op._id);
-	_symbol = std::move(op._symbol);
-	_type = std::move(op._type);
-	_priority = std::move(op._priority);
-	_rightToLeft = std::move(op._rightToLeft);
-	_conditional = std::move(op._conditional);
+	CodeFragment::operator=(std::move(op));
+	_id = op._id;
 	return *this;
 }
 
-unsigned int Operator::getPriority() const { return _priority; }
-bool Operator::hasRightToLeft() const { return _rightToLeft; }
-bool Operator::isConditional() const { return _conditional; }
+Operator::Id Operator::getId() const { return _id; }
+const char* Operator::getSymbol() const { return info(_id).symbol; }
+Operator::Type Operator::getType() const { return info(_id).type; }
+
+unsigned int Operator::getPriority() const { return info(_id).priority; }
+bool Operator::hasRightToLeft() const { return info(_id).rightToLeft; }
+bool Operator::isConditional() const { return info(_id).conditional; }
 
-bool Operator::isUnary() const { return _type == Type::Unary; }
-bool Operator::isBinary() const { return _type == Type::Binary; }
-bool Operator::isTernary() const { return _type == Type::Ternary; }
-bool Operator::isAssignment() const { return _type == Type::Assignment; }
+bool Operator::isUnary() const { return info(_id).type == Type::Unary; }
+bool Operator::isBinary() const { return info(_id).type == Type::Binary; }
+bool Operator::isTernary() const { return info(_id).type == Type::Ternary; }
+bool Operator::isAssignment() const { return info(_id).type == Type::Assignment; }
 
 int Operator::comparePriority(const Operator& other) const
 {
-	if (_priority == other._priority)
-		return _rightToLeft || other._rightToLeft ? -1 : 0;
-	return _priority < other._priority ? 1 : -1;
+	return operatorPriorities.compare[static_cast<size_t>(_id)][static_cast<size_t>(other._id)];
 }
 
 CodeFragmentType Operator::getCodeFragmentType() const { return CodeFragmentType::Operator; }
 
 bool Operator::isStatement() const { return false; }
 
-std::string Operator::toString(size_t identation) const { return _symbol; }
+std::string Operator::toString(size_t identation) const { return info(_id).symbol; }
 
 void* Operator::clone() const { return new Operator{ *this }; }
 
@@ -506,38 +645,72 @@ bool Operator::operator== (const CodeFragment& c) const
 bool Operator::operator== (const Operator& op) const { return _id == op._id; }
 bool Operator::operator!= (const Operator& op) const { return _id != op._id; }
 
-const Operator Operator::SufixIncrement{ "++", Operator::Type::Unary, 0, false, false };
-const Operator Operator::SufixDecrement{ "--", Operator::Type::Unary, 0, false, false };
+const Operator Operator::SufixIncrement{ Operator::Id::SufixIncrement };
+const Operator Operator::SufixDecrement{ Operator::Id::SufixDecrement };
+
+const Operator Operator::PrefixIncrement{ Operator::Id::PrefixIncrement };
+const Operator Operator::PrefixDecrement{ Operator::Id::PrefixDecrement };
+const Operator Operator::UnaryMinus{ Operator::Id::UnaryMinus };
+const Operator Operator::BinaryNot{ Operator::Id::BinaryNot };
 
-const Operator Operator::PrefixIncrement{ "++", Operator::Type::Unary, 1, true, false };
-const Operator Operator::PrefixDecrement{ "--", Operator::Type::Unary, 1, true, false };
-const Operator Operator::UnaryMinus{ "-", Operator::Type::Unary, 1, true, false };
-const Operator Operator::BinaryNot{ "!", Operator::Type::Unary, 1, true, false };
+const Operator Operator::Multiplication{ Operator::Id::Multiplication };
+const Operator Operator::Division{ Operator::Id::Division };
 
-const Operator Operator::Multiplication{ "*", Operator::Type::Binary, 2, false, false };
-const Operator Operator::Division{ "/", Operator::Type::Binary, 2, false, false };
+const Operator Operator::Addition{ Operator::Id::Addition };
+const Operator Operator::Subtraction{ Operator::Id::Subtraction };
 
-const Operator Operator::Addition{ "+", Operator::Type::Binary, 3, false, false };
-const Operator Operator::Subtraction{ "-", Operator::Type::Binary, 3, false, false };
+const Operator Operator::GreaterThan{ Operator::Id::GreaterThan };
+const Operator Operator::SmallerThan{ Operator::Id::SmallerThan };
+const Operator Operator::GreaterEqualsThan{ Operator::Id::GreaterEqualsThan };
+const Operator Operator::SmallerEqualsThan{ Operator::Id::SmallerEqualsThan };
 
-const Operator Operator::GreaterThan{ ">", Operator::Type::Binary, 4, false, true };
-const Operator Operator::SmallerThan{ "<", Operator::Type::Binary, 4, false, true };
-const Operator Operator::GreaterEqualsThan{ ">=", Operator::Type::Binary, 4, false, true };
-const Operator Operator::SmallerEqualsThan{ "<=", Operator::Type::Binary, 4, false, true };
+const Operator Operator::EqualsTo{ Operator::Id::EqualsTo };
+const Operator Operator::NotEqualsTo{ Operator::Id::NotEqualsTo };
 
-const Operator Operator::EqualsTo{ "==", Operator::Type::Binary, 5, false, true };
-const Operator Operator::NotEqualsTo{ "!=", Operator::Type::Binary, 5, false, true };
+const Operator Operator::BinaryAnd{ Operator::Id::BinaryAnd };
+const Operator Operator::BinaryOr{ Operator::Id::BinaryOr };
 
-const Operator Operator::BinaryAnd{ "&&", Operator::Type::Binary, 6, false, false };
-const Operator Operator::BinaryOr{ "||", Operator::Type::Binary, 6, false, false };
+const Operator Operator::TernaryConditional{ Operator::Id::TernaryConditional };
 
-const Operator Operator::TernaryConditional{ "?:", Operator::Type::Ternary, 7, false, false };
+const Operator Operator::Assignment{ Operator::Id::Assignment };
+const Operator Operator::AssignmentAddition{ Operator::Id::AssignmentAddition };
+const Operator Operator::AssignmentSubtraction{ Operator::Id::AssignmentSubtraction };
+const Operator Operator::AssignmentMultiplication{ Operator::Id::AssignmentMultiplication };
+const Operator Operator::AssignmentDivision{ Operator::Id::AssignmentDivision };
 
-const Operator Operator::Assignment{ "=", Operator::Type::Assignment, 8, true, false };
-const Operator Operator::AssignmentAddition{ "+=", Operator::Type::Assignment, 8, true, false };
-const Operator Operator::AssignmentSubtraction{ "-=", Operator::Type::Assignment, 8, true, false };
-const Operator Operator::AssignmentMultiplication{ "*=", Operator::Type::Assignment, 8, true, false };
-const Operator Operator::AssignmentDivision{ "/=", Operator::Type::Assignment, 8, true, false };
+const Operator& Operator::get(Id id)
+{
+	static const Operator* const operators[COUNT] = {
+		&SufixIncrement,
+		&SufixDecrement,
+		&PrefixIncrement,
+		&PrefixDecrement,
+		&UnaryMinus,
+		&BinaryNot,
+		&Multiplication,
+		&Division,
+		&Addition,
+		&Subtraction,
+		&GreaterThan,
+		&SmallerThan,
+		&GreaterEqualsThan,
+		&SmallerEqualsThan,
+		&EqualsTo,
+		&NotEqualsTo,
+		&BinaryAnd,
+		&BinaryOr,
+		&TernaryConditional,
+		&Assignment,
+		&AssignmentAddition,
+		&AssignmentSubtraction,
+		&AssignmentMultiplication,
+		&AssignmentDivision
+	};
+
+	if (static_cast<size_t>(id) >= COUNT)
+		throw BadIndex{ static_cast<size_t>(id), 0, COUNT };
+	return *operators[static_cast<size_t>(id)];
+}
 
 
 
@@ -555,9 +728,14 @@ Operation::BadOperation::BadOperation(const char* msg) :
 
 Operation::Operation(const Operator& op, const Statement& operand0, const Statement* operand1, const Statement* operand2) :
 	Statement{},
-	_operator{ op },
+	_operator{ op.getId() },
 	_operands{ operand0, operand1, operand2 }
-{}
+{
+	size_t hash = structural_hash(CodeFragmentType::Operation, static_cast<size_t>(_operator));
+	for (const CloneableAllocator<Statement>& operand : _operands)
+		hash = hash_combine(hash, structural_hash(operand));
+	setStructuralHash(hash);
+}
 Operation::Operation(const Operation& o) :
 	Statement{ o },
 	_operator{ o._operator },
@@ -565,13 +743,34 @@ Operation::Operation(const Operation& o) :
 {}
 Operation::Operation(Operation&& o) noexcept :
 	Statement{ std::move(o) },
-	_operator{ std::move(o._operator) },
+	_operator{ o._operator },
 	_operands{ std::move(o._operands[0]), std::move(o._operands[1]), std::move(o._operands[2]) }
 {}
-Operation::~Operation() {}
+Operation::~Operation()
+{
+	/* Deep operation chains are torn down from a work list, not one destructor frame per level */
+	static thread_local std::vector<CloneableAllocator<Statement>> pending;
+	static thread_local bool draining = false;
+
+	for (CloneableAllocator<Statement>& operand : _operands)
+		if (operand.unique() && static_cast<const Statement&>(operand).is(CodeFragmentType::Operation))
+			pending.push_back(std::move(operand));
+
+	if (draining)
+		return;
+
+	draining = true;
+	while (!pending.empty())
+	{
+		CloneableAllocator<Statement> operation = std::move(pending.back());
+		pending.pop_back();
+	}
+	draining = false;
+}
 
 Operation& Operation::operator= (const Operation& o)
 {
+	Statement::operator=(o);
 	_operator = o._operator;
 	_operands[0] = o._operands[0];
 	_operands[1] = o._operands[1];
@@ -580,23 +779,25 @@ Operation& Operation::operator= (const Operation& o)
 }
 Operation& Operation::operator= (Operation&& o) noexcept
 {
-	_operator = std::move(o._operator);
+	Statement::operator=(std::move(o));
+	_operator = o._operator;
 	_operands[0] = std::move(o._operands[0]);
 	_operands[1] = std::move(o._operands[1]);
 	_operands[2] = std::move(o._operands[2]);
 	return *this;
 }
 
-bool Operation::isUnary() const { return _operator.isUnary(); }
-bool Operation::isBinary() const { return _operator.isBinary(); }
-bool Operation::isTernary() const { return _operator.isTernary(); }
-bool Operation::isAssignment() const { return _operator.isAssignment(); }
+bool Operation::isUnary() const { return getOperator().isUnary(); }
+bool Operation::isBinary() const { return getOperator().isBinary(); }
+bool Operation::isTernary() const { return getOperator().isTernary(); }
+bool Operation::isAssignment() const { return getOperator().isAssignment(); }
 
-const Operator& Operation::getOperator() const { return _operator; }
+const Operator& Operation::getOperator() const { return Operator::get(_operator); }
 
 size_t Operation::getOperandCount() const
 {
-	return _operator.isUnary() ? 1 : _operator.isTernary() ? 3 : 2;
+	const Operator& op = getOperator();
+	return op.isUnary() ? 1 : op.isTernary() ? 3 : 2;
 }
 const Statement& Operation::getOperand(const size_t idx) const { return _operands[idx]; }
 
@@ -604,16 +805,17 @@ CodeFragmentType Operation::getCodeFragmentType() const { return CodeFragmentTyp
 
 std::string Operation::toString(size_t identation) const
 {
-	if (_operator.isUnary())
+	const Operator& op = getOperator();
+	if (op.isUnary())
 	{
-		return _operator == Operator::SufixIncrement || _operator == Operator::SufixDecrement
-			? _operands[0]->toString() + _operator.toString()
-			: _operator.toString() + _operands[0]->toString();
+		return _operator == Operator::Id::SufixIncrement || _operator == Operator::Id::SufixDecrement
+			? _operands[0]->toString() + op.toString()
+			: op.toString() + _operands[0]->toString();
 	}
-	if (_operator.isTernary())
+	if (op.isTernary())
 		return _operands[0]->toString() + " ? " + _operands[1]->toString() + " : " + _operands[2]->toString();
 
-	return _operands[0]->toString() + " " + " " + _operator.toString() + _operands[1]->toString();
+	return _operands[0]->toString() + " " + " " + op.toString() + _operands[1]->toString();
 }
 
 void* Operation::clone() const { return new Operation{ *this }; }
@@ -624,8 +826,8 @@ bool Operation::operator== (const CodeFragment& c) const
 		return operator==(reinterpret_cast<const Operation&>(c));
 	return false;
 }
-bool Operation::operator== (const Operation& o) const { return _operator == o._operator && _operands[0] == o._operands[0] && _operands[1] == o._operands[1] && _operands[2] == o._operands[2]; }
-bool Operation::operator!= (const Operation& o) const { return _operator != o._operator || _operands[0] != o._operands[0] || _operands[1] != o._operands[1] || _operands[2] != o._operands[2]; }
+bool Operation::operator== (const Operation& o) const { return structuralHash() == o.structuralHash() && _operator == o._operator && _operands[0] == o._operands[0] && _operands[1] == o._operands[1] && _operands[2] == o._operands[2]; }
+bool Operation::operator!= (const Operation& o) const { return structuralHash() != o.structuralHash() || _operator != o._operator || _operands[0] != o._operands[0] || _operands[1] != o._operands[1] || _operands[2] != o._operands[2]; }
 
 Operation Operation::unary(const Operator& op, const Statement& operand)
 {
@@ -673,16 +875,23 @@ FunctionCall::BadFunctionCall::BadFunctionCall(const char* msg) :
 FunctionCall::FunctionCall() :
 	_callable{ nullptr },
 	_args{}
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::FunctionCall, 0));
+}
 FunctionCall::FunctionCall(const Callable& callable, const FunctionArguments& args) :
 	_callable{ &callable },
 	_args{ args }
-{}
+{
+	const size_t hash = structural_hash(CodeFragmentType::FunctionCall, static_cast<size_t>(callable.code()));
+	setStructuralHash(hash_combine(hash, args.structuralHash()));
+}
 FunctionCall::FunctionCall(const FunctionCall& fc) :
+	Statement{ fc },
 	_callable{ fc._callable },
 	_args{ fc._args }
 {}
 FunctionCall::FunctionCall(FunctionCall&& fc) noexcept :
+	Statement{ std::move(fc) },
 	_callable{ std::move(fc._callable) },
 	_args{ std::move(fc._args) }
 {}
@@ -690,12 +899,14 @@ FunctionCall::~FunctionCall() {}
 
 FunctionCall& FunctionCall::operator= (const FunctionCall& fc)
 {
+	Statement::operator=(fc);
 	_callable = fc._callable;
 	_args = fc._args;
 	return *this;
 }
 FunctionCall& FunctionCall::operator= (FunctionCall&& fc) noexcept
 {
+	Statement::operator=(std::move(fc));
 	_callable = std::move(fc._callable);
 	_args = std::move(fc._args);
 	return *this;
@@ -718,12 +929,16 @@ bool FunctionCall::operator== (const CodeFragment& c) const
 }
 bool FunctionCall::operator== (const FunctionCall& fc) const
 {
+	if (structuralHash() != fc.structuralHash())
+		return false;
 	if (!_callable)
 		return !fc._callable;
 	return fc._callable && *_callable == *fc._callable && _args == fc._args;
 }
 bool FunctionCall::operator!= (const FunctionCall& fc) const
 {
+	if (structuralHash() != fc.structuralHash())
+		return true;
 	if (!_callable)
 		return fc._callable;
 	return !fc._callable || *_callable != *fc._callable || _args != fc._args;
@@ -748,19 +963,24 @@ FunctionCall FunctionCall::make(const Callable& callable, const Statement& args)
 Command::Command() :
 	_id{ 0 },
 	_name{}
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::Command, _id));
+}
 Command::Command(const std::string& name) :
 	_id{},
 	_name{ name }
 {
 	static uint8_t id_gen = 0;
 	_id = ++id_gen;
+	setStructuralHash(structural_hash(CodeFragmentType::Command, _id));
 }
 Command::Command(const Command& c) :
+	CodeFragment{ c },
 	_id{ c._id },
 	_name{ c._name }
 {}
 Command::Command(Command&& c) noexcept :
+	CodeFragment{ std::move(c) },
 	_id{ std::move(c._id) },
 	_name{ std::move(c._name) }
 {}
@@ -768,12 +988,14 @@ Command::~Command() {}
 
 Command& Command::operator= (const Command& c)
 {
+	CodeFragment::operator=(c);
 	_id = c._id;
 	_name = c._name;
 	return *this;
 }
 Command& Command::operator= (Command&& c) noexcept
 {
+	CodeFragment::operator=(std::move(c));
 	_id = std::move(c._id);
 	_name = std::move(c._name);
 	return *this;
@@ -805,6 +1027,40 @@ const Command Command::If{ "if" };
 const Command Command::Else{ "else" };
 const Command Command::Every{ "every" };
 
+namespace
+{
+	constexpr perfect_hash::Entry<uint8_t> command_names[] = {
+		{ "var", 0 },
+		{ "const", 1 },
+		{ "define", 2 },
+		{ "import", 3 },
+		{ "if", 4 },
+		{ "else", 5 },
+		{ "every", 6 }
+	};
+
+	constexpr perfect_hash::Table<uint8_t, sizeof(command_names) / sizeof(*command_names), 16> commands_by_name{ command_names };
+
+	static_assert(commands_by_name.isValid(), "No perfect hash found for the command names");
+
+	const Command* const commands[] = {
+		&Command::Var,
+		&Command::Const,
+		&Command::Define,
+		&Command::Import,
+		&Command::If,
+		&Command::Else,
+		&Command::Every
+	};
+}
+
+const Command* Command::find(const std::string& name) { return find(name.data(), name.size()); }
+const Command* Command::find(const char* name, size_t length)
+{
+	const uint8_t* index = commands_by_name.find(name, length);
+	return index ? commands[*index] : nullptr;
+}
+
 
 
 
@@ -844,22 +1100,28 @@ bool Instruction::operator== (const CodeFragment& c) const
 
 Scope::Scope() :
 	_insts{}
-{}
+{
+	setStructuralHash(structural_hash(CodeFragmentType::Scope, 0));
+}
 Scope::Scope(const Scope& s) :
+	CodeFragment{ s },
 	_insts{ s._insts }
 {}
 Scope::Scope(Scope&& s) noexcept :
+	CodeFragment{ std::move(s) },
 	_insts{ std::move(s._insts) }
 {}
 Scope::~Scope() {}
 
 Scope& Scope::operator= (const Scope& s)
 {
+	CodeFragment::operator=(s);
 	_insts = s._insts;
 	return *this;
 }
 Scope& Scope::operator= (Scope&& s) noexcept
 {
+	CodeFragment::operator=(std::move(s));
 	_insts = std::move(s._insts);
 	return *this;
 }
@@ -871,7 +1133,11 @@ const Instruction& Scope::getInstruction(size_t idx) const { return _insts[idx];
 
 const CloneableVector<Instruction>& Scope::getAllInstructions() const { return _insts; }
 
-void Scope::addInstruction(const Instruction& inst) { _insts.push_back(inst); }
+void Scope::addInstruction(const Instruction& inst)
+{
+	_insts.push_back(inst);
+	setStructuralHash(hash_combine(structuralHash(), inst.structuralHash()));
+}
 
 CodeFragmentType Scope::getCodeFragmentType() const { return CodeFragmentType::Scope; }
 
@@ -901,8 +1167,8 @@ bool Scope::operator== (const CodeFragment& c) const
 		return operator==(reinterpret_cast<const Scope&>(c));
 	return false;
 }
-bool Scope::operator== (const Scope& s) const { return _insts == s._insts; }
-bool Scope::operator!= (const Scope& s) const { return _insts != s._insts; }
+bool Scope::operator== (const Scope& s) const { return structuralHash() == s.structuralHash() && _insts == s._insts; }
+bool Scope::operator!= (const Scope& s) const { return structuralHash() != s.structuralHash() || _insts != s._insts; }
 
 const Instruction& Scope::operator[] (size_t idx) const { return _insts[idx]; }
 
@@ -919,11 +1185,15 @@ const Instruction& Scope::operator[] (size_t idx) const { return _insts[idx]; }
 InstructionStatement::InstructionStatement() :
 	Instruction{},
 	_statement{}
-{}
+{
+	setStructuralHash(structural_hash(Type::Statement));
+}
 InstructionStatement::InstructionStatement(const Statement& statement) :
 	Instruction{},
 	_statement{ statement }
-{}
+{
+	setStructuralHash(hash_combine(structural_hash(Type::Statement), statement.structuralHash()));
+}
 InstructionStatement::InstructionStatement(const InstructionStatement& inst) :
 	Instruction{ inst },
 	_statement{ inst._statement }
@@ -936,11 +1206,13 @@ InstructionStatement::~InstructionStatement() {}
 
 InstructionStatement& InstructionStatement::operator= (const InstructionStatement& inst)
 {
+	Instruction::operator=(inst);
 	_statement = inst._statement;
 	return *this;
 }
 InstructionStatement& InstructionStatement::operator= (InstructionStatement&& inst) noexcept
 {
+	Instruction::operator=(std::move(inst));
 	_statement = std::move(inst._statement);
 	return *this;
 }
@@ -966,8 +1238,8 @@ bool InstructionStatement::operator== (const Instruction& inst) const
 		return operator==(reinterpret_cast<const InstructionStatement&>(inst));
 	return false;
 }
-bool InstructionStatement::operator== (const InstructionStatement& inst) const { return _statement == inst._statement; }
-bool InstructionStatement::operator!= (const InstructionStatement& inst) const { return _statement != inst._statement; }
+bool InstructionStatement::operator== (const InstructionStatement& inst) const { return structuralHash() == inst.structuralHash() && _statement == inst._statement; }
+bool InstructionStatement::operator!= (const InstructionStatement& inst) const { return structuralHash() != inst.structuralHash() || _statement != inst._statement; }
 
 
 
@@ -982,11 +1254,15 @@ bool InstructionStatement::operator!= (const InstructionStatement& inst) const {
 InstructionStatementScope::InstructionStatementScope() :
 	Instruction{},
 	_insts{}
-{}
+{
+	setStructuralHash(structural_hash(Type::StatementScope));
+}
 InstructionStatementScope::InstructionStatementScope(const Scope& scope) :
 	Instruction{},
 	_insts{ scope.getAllInstructions() }
-{}
+{
+	setStructuralHash(structural_hash(structural_hash(Type::StatementScope), _insts));
+}
 InstructionStatementScope::InstructionStatementScope(const InstructionStatementScope& inst) :
 	Instruction{ inst },
 	_insts{ inst._insts }
@@ -999,11 +1275,13 @@ InstructionStatementScope::~InstructionStatementScope() {}
 
 InstructionStatementScope& InstructionStatementScope::operator= (const InstructionStatementScope& inst)
 {
+	Instruction::operator=(inst);
 	_insts = inst._insts;
 	return *this;
 }
 InstructionStatementScope& InstructionStatementScope::operator= (InstructionStatementScope&& inst) noexcept
 {
+	Instruction::operator=(std::move(inst));
 	_insts = std::move(inst._insts);
 	return *this;
 }
@@ -1025,8 +1303,8 @@ bool InstructionStatementScope::operator== (const Instruction& inst) const
 		return operator==(reinterpret_cast<const InstructionStatementScope&>(inst));
 	return false;
 }
-bool InstructionStatementScope::operator== (const InstructionStatementScope& inst) const { return _insts == inst._insts; }
-bool InstructionStatementScope::operator!= (const InstructionStatementScope& inst) const { return _insts != inst._insts; }
+bool InstructionStatementScope::operator== (const InstructionStatementScope& inst) const { return structuralHash() == inst.structuralHash() && _insts == inst._insts; }
+bool InstructionStatementScope::operator!= (const InstructionStatementScope& inst) const { return structuralHash() != inst.structuralHash() || _insts != inst._insts; }
 
 const Instruction& InstructionStatementScope::operator[] (size_t idx) const { return _insts[idx]; }
 
@@ -1064,25 +1342,36 @@ bool InstructionVarDeclaration::Entry::operator!= (const InstructionVarDeclarati
 
 InstructionVarDeclaration::InstructionVarDeclaration() :
 	_entries{}
-{}
+{
+	setStructuralHash(structural_hash(Type::VarDeclaration));
+}
 InstructionVarDeclaration::InstructionVarDeclaration(const std::vector<Entry>& entries) :
 	_entries{ entries }
-{}
+{
+	size_t hash = structural_hash(Type::VarDeclaration);
+	for (const Entry& e : _entries)
+		hash = hash_combine(hash_combine(hash, e.getIdentifier().structuralHash()), e.hasInitValue() ? e.getInitValue().structuralHash() : 0);
+	setStructuralHash(hash);
+}
 InstructionVarDeclaration::InstructionVarDeclaration(const InstructionVarDeclaration& inst) :
+	Instruction{ inst },
 	_entries{ inst._entries }
 {}
 InstructionVarDeclaration::InstructionVarDeclaration(InstructionVarDeclaration&& inst) noexcept :
+	Instruction{ std::move(inst) },
 	_entries{ std::move(inst._entries) }
 {}
 InstructionVarDeclaration::~InstructionVarDeclaration() {}
 
 InstructionVarDeclaration& InstructionVarDeclaration::operator= (const InstructionVarDeclaration& inst)
 {
+	Instruction::operator=(inst);
 	_entries = inst._entries;
 	return *this;
 }
 InstructionVarDeclaration& InstructionVarDeclaration::operator= (InstructionVarDeclaration&& inst) noexcept
 {
+	Instruction::operator=(std::move(inst));
 	_entries = std::move(inst._entries);
 	return *this;
 }
@@ -1125,8 +1414,8 @@ bool InstructionVarDeclaration::operator== (const Instruction& inst) const
 		return operator==(reinterpret_cast<const InstructionVarDeclaration&>(inst));
 	return false;
 }
-bool InstructionVarDeclaration::operator== (const InstructionVarDeclaration& inst) const { return _entries == inst._entries; }
-bool InstructionVarDeclaration::operator!= (const InstructionVarDeclaration& inst) const { return _entries != inst._entries; }
+bool InstructionVarDeclaration::operator== (const InstructionVarDeclaration& inst) const { return structuralHash() == inst.structuralHash() && _entries == inst._entries; }
+bool InstructionVarDeclaration::operator!= (const InstructionVarDeclaration& inst) const { return structuralHash() != inst.structuralHash() || _entries != inst._entries; }
 
 const InstructionVarDeclaration::Entry& InstructionVarDeclaration::operator[] (size_t idx) const { return _entries[idx]; }
 
@@ -1160,25 +1449,36 @@ bool InstructionConstDeclaration::Entry::operator!= (const InstructionConstDecla
 
 InstructionConstDeclaration::InstructionConstDeclaration() :
 	_entries{}
-{}
+{
+	setStructuralHash(structural_hash(Type::ConstDeclaration));
+}
 InstructionConstDeclaration::InstructionConstDeclaration(const std::vector<Entry>& entries) :
 	_entries{ entries }
-{}
+{
+	size_t hash = structural_hash(Type::ConstDeclaration);
+	for (const Entry& e : _entries)
+		hash = hash_combine(hash_combine(hash, e.getIdentifier().structuralHash()), static_cast<size_t>(e.getInitValue()));
+	setStructuralHash(hash);
+}
 InstructionConstDeclaration::InstructionConstDeclaration(const InstructionConstDeclaration& inst) :
+	Instruction{ inst },
 	_entries{ inst._entries }
 {}
 InstructionConstDeclaration::InstructionConstDeclaration(InstructionConstDeclaration&& inst) noexcept :
+	Instruction{ std::move(inst) },
 	_entries{ std::move(inst._entries) }
 {}
 InstructionConstDeclaration::~InstructionConstDeclaration() {}
 
 InstructionConstDeclaration& InstructionConstDeclaration::operator= (const InstructionConstDeclaration& inst)
 {
+	Instruction::operator=(inst);
 	_entries = inst._entries;
 	return *this;
 }
 InstructionConstDeclaration& InstructionConstDeclaration::operator= (InstructionConstDeclaration&& inst) noexcept
 {
+	Instruction::operator=(std::move(inst));
 	_entries = std::move(inst._entries);
 	return *this;
 }
@@ -1219,8 +1519,8 @@ bool InstructionConstDeclaration::operator== (const Instruction& inst) const
 		return operator==(reinterpret_cast<const InstructionConstDeclaration&>(inst));
 	return false;
 }
-bool InstructionConstDeclaration::operator== (const InstructionConstDeclaration& inst) const { return _entries == inst._entries; }
-bool InstructionConstDeclaration::operator!= (const InstructionConstDeclaration& inst) const { return _entries != inst._entries; }
+bool InstructionConstDeclaration::operator== (const InstructionConstDeclaration& inst) const { return structuralHash() == inst.structuralHash() && _entries == inst._entries; }
+bool InstructionConstDeclaration::operator!= (const InstructionConstDeclaration& inst) const { return structuralHash() != inst.structuralHash() || _entries != inst._entries; }
 
 const InstructionConstDeclaration::Entry& InstructionConstDeclaration::operator[] (size_t idx) const { return _entries[idx]; }
 
@@ -1241,18 +1541,26 @@ InstructionConditional::InstructionConditional() :
 	_condition{},
 	_block{},
 	_elseBlock{}
-{}
+{
+	setStructuralHash(structural_hash(Type::Conditional));
+}
 InstructionConditional::InstructionConditional(const Statement& condition, const Instruction& block, const Instruction* elseBlock) :
 	_condition{ condition },
 	_block{ block },
 	_elseBlock{ elseBlock }
-{}
+{
+	size_t hash = hash_combine(structural_hash(Type::Conditional), condition.structuralHash());
+	hash = hash_combine(hash, block.structuralHash());
+	setStructuralHash(hash_combine(hash, elseBlock ? elseBlock->structuralHash() : 0));
+}
 InstructionConditional::InstructionConditional(const InstructionConditional& inst) :
+	Instruction{ inst },
 	_condition{ inst._condition },
 	_block{ inst._block },
 	_elseBlock{ inst._elseBlock }
 {}
 InstructionConditional::InstructionConditional(InstructionConditional&& inst) noexcept :
+	Instruction{ std::move(inst) },
 	_condition{ std::move(inst._condition) },
 	_block{ std::move(inst._block) },
 	_elseBlock{ std::move(inst._elseBlock) }
@@ -1261,6 +1569,7 @@ InstructionConditional::~InstructionConditional() {}
 
 InstructionConditional& InstructionConditional::operator= (const InstructionConditional& inst)
 {
+	Instruction::operator=(inst);
 	_condition = inst._condition;
 	_block = inst._block;
 	_elseBlock = inst._elseBlock;
@@ -1268,6 +1577,7 @@ InstructionConditional& InstructionConditional::operator= (const InstructionCond
 }
 InstructionConditional& InstructionConditional::operator= (InstructionConditional&& inst) noexcept
 {
+	Instruction::operator=(std::move(inst));
 	_condition = std::move(inst._condition);
 	_block = std::move(inst._block);
 	_elseBlock = std::move(inst._elseBlock);
@@ -1305,8 +1615,8 @@ bool InstructionConditional::operator== (const Instruction& inst) const
 		return operator==(reinterpret_cast<const InstructionConditional&>(inst));
 	return false;
 }
-bool InstructionConditional::operator== (const InstructionConditional& inst) const { return _condition == inst._condition && _block == inst._block && _elseBlock == inst._elseBlock; }
-bool InstructionConditional::operator!= (const InstructionConditional& inst) const { return _condition != inst._condition || _block != inst._block || _elseBlock != inst._elseBlock; }
+bool InstructionConditional::operator== (const InstructionConditional& inst) const { return structuralHash() == inst.structuralHash() && _condition == inst._condition && _block == inst._block && _elseBlock == inst._elseBlock; }
+bool InstructionConditional::operator!= (const InstructionConditional& inst) const { return structuralHash() != inst.structuralHash() || _condition != inst._condition || _block != inst._block || _elseBlock != inst._elseBlock; }
 
 
 
@@ -1346,16 +1656,22 @@ constexpr size_t EVERY_FIRST_VALUE_LEN = sizeof(EVERY_FIRST_VALUE) / sizeof(Code
 InstructionEveryLoop::InstructionEveryLoop() :
 	_turns{},
 	_block{}
-{}
+{
+	setStructuralHash(structural_hash(Type::EveryLoop));
+}
 InstructionEveryLoop::InstructionEveryLoop(CodeValue turns, const Instruction& block) :
 	_turns{ turns },
 	_block{ block }
-{}
+{
+	setStructuralHash(hash_combine(hash_combine(structural_hash(Type::EveryLoop), static_cast<size_t>(turns)), block.structuralHash()));
+}
 InstructionEveryLoop::InstructionEveryLoop(const InstructionEveryLoop& inst) :
+	Instruction{ inst },
 	_turns{ inst._turns },
 	_block{ inst._block }
 {}
 InstructionEveryLoop::InstructionEveryLoop(InstructionEveryLoop&& inst) noexcept :
+	Instruction{ std::move(inst) },
 	_turns{ std::move(inst._turns) },
 	_block{ std::move(inst._block) }
 {}
@@ -1363,12 +1679,14 @@ InstructionEveryLoop::~InstructionEveryLoop() {}
 
 InstructionEveryLoop& InstructionEveryLoop::operator= (const InstructionEveryLoop& inst)
 {
+	Instruction::operator=(inst);
 	_turns = inst._turns;
 	_block = inst._block;
 	return *this;
 }
 InstructionEveryLoop& InstructionEveryLoop::operator= (InstructionEveryLoop&& inst) noexcept
 {
+	Instruction::operator=(std::move(inst));
 	_turns = std::move(inst._turns);
 	_block = std::move(inst._block);
 	return *this;
@@ -1419,8 +1737,8 @@ bool InstructionEveryLoop::operator== (const Instruction& inst) const
 		return operator==(reinterpret_cast<const InstructionEveryLoop&>(inst));
 	return false;
 }
-bool InstructionEveryLoop::operator== (const InstructionEveryLoop& inst) const { return _turns == inst._turns && _block == inst._block; }
-bool InstructionEveryLoop::operator!= (const InstructionEveryLoop& inst) const { return _turns != inst._turns || _block != inst._block; }
+bool InstructionEveryLoop::operator== (const InstructionEveryLoop& inst) const { return structuralHash() == inst.structuralHash() && _turns == inst._turns && _block == inst._block; }
+bool InstructionEveryLoop::operator!= (const InstructionEveryLoop& inst) const { return structuralHash() != inst.structuralHash() || _turns != inst._turns || _block != inst._block; }
 
 
 
@@ -1435,15 +1753,21 @@ bool InstructionEveryLoop::operator!= (const InstructionEveryLoop& inst) const {
 
 CodeFragmentList::CodeFragmentList() :
 	_code{},
-	_sourceLine{}
+	_sourceLine{},
+	_kindIndex{},
+	_hashIndex{}
 {}
 CodeFragmentList::CodeFragmentList(const size_t sourceLine, const CodeFragment& cf) :
 	_code{ CloneableAllocator{ cf } },
-	_sourceLine{ sourceLine }
+	_sourceLine{ sourceLine },
+	_kindIndex{},
+	_hashIndex{}
 {}
 CodeFragmentList::CodeFragmentList(const size_t sourceLine, const std::vector<CodeFragment*>& code) :
 	_code{ code.size() },
-	_sourceLine{ sourceLine }
+	_sourceLine{ sourceLine },
+	_kindIndex{},
+	_hashIndex{}
 {
 	if (!_code.empty())
 	{
@@ -1457,24 +1781,33 @@ CodeFragmentList::CodeFragmentList(const size_t sourceLine, const std::vector<Co
 }
 CodeFragmentList::CodeFragmentList(const size_t sourceLine, const std::vector<CloneableAllocator<CodeFragment>>& code) :
 	_code{ code },
-	_sourceLine{ sourceLine }
+	_sourceLine{ sourceLine },
+	_kindIndex{},
+	_hashIndex{}
 {}
 CodeFragmentList::CodeFragmentList(const size_t sourceLine, const CloneableVector<CodeFragment>& code) :
 	_code{ code.stdvector() },
-	_sourceLine{ sourceLine }
+	_sourceLine{ sourceLine },
+	_kindIndex{},
+	_hashIndex{}
 {}
 CodeFragmentList::CodeFragmentList(const size_t sourceLine, const CodeFragmentList& fl) :
 	_code{ fl._code },
-	_sourceLine{ sourceLine }
+	_sourceLine{ sourceLine },
+	_kindIndex{ fl._kindIndex },
+	_hashIndex{ fl._hashIndex }
 {}
 CodeFragmentList::CodeFragmentList(const CodeFragmentList& fl) :
 	_code{ fl._code },
-	_sourceLine{ fl._sourceLine }
+	_sourceLine{ fl._sourceLine },
+	_kindIndex{ fl._kindIndex },
+	_hashIndex{ fl._hashIndex }
 {}
 CodeFragmentList::CodeFragmentList(CodeFragmentList&& fl) noexcept :
-	_code{ std::move(fl._code) }
-	,
-	_sourceLine{ std::move(fl._sourceLine) }
+	_code{ std::move(fl._code) },
+	_sourceLine{ std::move(fl._sourceLine) },
+	_kindIndex{ std::move(fl._kindIndex) },
+	_hashIndex{ std::move(fl._hashIndex) }
 {}
 CodeFragmentList::~CodeFragmentList() {}
 
@@ -1482,12 +1815,16 @@ CodeFragmentList& CodeFragmentList::operator= (const CodeFragmentList& fl)
 {
 	_code = fl._code;
 	_sourceLine = fl._sourceLine;
+	_kindIndex = fl._kindIndex;
+	_hashIndex = fl._hashIndex;
 	return *this;
 }
 CodeFragmentList& CodeFragmentList::operator= (CodeFragmentList&& fl) noexcept
 {
 	_code = std::move(fl._code);
 	_sourceLine = std::move(fl._sourceLine);
+	_kindIndex = std::move(fl._kindIndex);
+	_hashIndex = std::move(fl._hashIndex);
 	return *this;
 }
 
@@ -1500,10 +1837,14 @@ size_t CodeFragmentList::sourceLine() const { return _sourceLine; }
 
 const std::vector<CloneableAllocator<CodeFragment>>& CodeFragmentList::code() const { return _code; }
 
-void CodeFragmentList::set(const size_t index, const CodeFragment& code) { _code[index] = code; }
+void CodeFragmentList::set(const size_t index, const CodeFragment& code)
+{
+	_code[index] = code;
+	_kindIndex = nullptr;
+	_hashIndex = nullptr;
+}
 const CodeFragment& CodeFragmentList::get(const size_t index) const { return _code[index]; }
 
-CodeFragment& CodeFragmentList::operator[] (const size_t index) { return _code[index]; }
 const CodeFragment& CodeFragmentList::operator[] (const size_t index) const { return _code[index]; }
 
 CodeFragmentList::CodeFragmentList(const size_t sourceLine, const std::vector<CodeFragment*> code, const size_t off, const size_t len) :
@@ -1519,14 +1860,24 @@ CodeFragmentList::CodeFragmentList(const size_t sourceLine, const CloneableVecto
 CodeFragmentList CodeFragmentList::sublist(const size_t off, const size_t len) const { return { _sourceLine, _code, off, len }; }
 CodeFragmentList CodeFragmentList::sublist(const size_t off) const { return { _sourceLine, _code, off, _code.size() - off }; }
 
+CodeFragmentSpan CodeFragmentList::span() const { return { *this }; }
+CodeFragmentSpan CodeFragmentList::span(const size_t off, const size_t len) const { return { *this, off, len }; }
+CodeFragmentSpan CodeFragmentList::span(const size_t off) const { return { *this, off, _code.size() - off }; }
+
 CodeFragmentList CodeFragmentList::concat(const CodeFragmentList& fl) const
 {
-	std::vector<CloneableAllocator<CodeFragment>> res{ _code.size() + fl.size() };
-	std::copy(_code.begin(), _code.end(), res.begin());
-	std::copy(fl._code.begin(), fl._code.end(), res.begin() + _code.size());
+	Builder builder{ _sourceLine };
+	builder.reserve(_code.size() + fl._code.size());
+	return builder.append(*this).append(fl).freeze();
+}
 
-	return { std::min(_sourceLine, fl._sourceLine), std::move(res) };
+CodeFragmentList& CodeFragmentList::operator+= (const CodeFragmentList& fl)
+{
+	if (&fl == this)
+		return operator=(concat(fl));
+	return operator=(Builder{ std::move(*this) }.append(fl).freeze());
 }
+CodeFragmentList& CodeFragmentList::operator+= (const CodeFragment& code) { return operator=(Builder{ std::move(*this) }.append(code).freeze()); }
 
 CodeFragmentList operator+ (const CodeFragmentList& fl0, const CodeFragmentList& fl1) { return fl0.concat(fl1); }
 CodeFragmentList operator+ (const CodeFragmentList& fl, const CodeFragment& code) { return fl.concat(CodeFragmentList{ fl._sourceLine, code }); }
@@ -1539,35 +1890,380 @@ CodeFragmentList operator+ (const std::vector<CodeFragment*>& code, const CodeFr
 CodeFragmentList operator+ (const std::vector<CloneableAllocator<CodeFragment>>& code, const CodeFragmentList& fl) { return CodeFragmentList{ fl._sourceLine, code }.concat(fl); }
 CodeFragmentList operator+ (const CloneableVector<CodeFragment>& code, const CodeFragmentList& fl) { return CodeFragmentList{ fl._sourceLine, code }.concat(fl); }
 
-CodeFragmentList CodeFragmentList::concatMiddle(const size_t index, const CodeFragmentList& fl) const
+CodeFragmentList CodeFragmentList::concatMiddle(const size_t index, const CodeFragmentList& fl) const { return Builder{ *this }.insert(index, fl).freeze(); }
+
+CodeFragmentList CodeFragmentList::wrapBetween(const CodeFragmentList& before, const CodeFragmentList& after) const
 {
-	if (index == 0)
-		return concat(fl);
-	if (index == _code.size())
-		return fl.concat(*this);
-	return sublist(0, index).concat(fl).concat(sublist(index));
+	Builder builder{ _sourceLine };
+	builder.reserve(before._code.size() + _code.size() + after._code.size());
+	return builder.append(before).append(*this).append(after).freeze();
 }
 
-CodeFragmentList CodeFragmentList::extract(const CodeFragment& from, const CodeFragment& to) const
+CodeFragmentList CodeFragmentList::extract(const CodeFragment& from, const CodeFragment& to) const { return span().extract(from, to).toList(); }
+
+size_t CodeFragmentList::count(const CodeFragment& code) const { return span().count(code); }
+size_t CodeFragmentList::count(CodeFragmentType codeType) const { return span().count(codeType); }
+
+bool CodeFragmentList::has(const CodeFragment& code) const { return span().has(code); }
+bool CodeFragmentList::has(CodeFragmentType codeType) const { return kindIndex().has(codeType); }
+
+bool CodeFragmentList::indexOf(const CodeFragment& code, size_t& outIndex) const { return span().indexOf(code, outIndex); }
+bool CodeFragmentList::indexOf(CodeFragmentType codeType, size_t& outIndex) const { return span().indexOf(codeType, outIndex); }
+
+bool CodeFragmentList::lastIndexOf(const CodeFragment& code, size_t& outIndex) const { return span().lastIndexOf(code, outIndex); }
+bool CodeFragmentList::lastIndexOf(CodeFragmentType codeType, size_t& outIndex) const { return span().lastIndexOf(codeType, outIndex); }
+
+std::vector<CodeFragmentList> CodeFragmentList::split(const CodeFragment& separator, int limit) const
 {
-	bool init = false;
+	if (_code.empty() || limit == 1)
+		return { *this };
+
+	std::vector<CodeFragmentList> parts;
+	for (const CodeFragmentSpan& part : span().split(separator, limit))
+		parts.push_back(part.toList());
+	return parts;
+}
+
+bool CodeFragmentList::indexOfHash(size_t hash, size_t& outIndex) const
+{
+	auto positions = hashIndex().find(hash, 0, _code.size());
+	if (positions.first == positions.second)
+		return false;
+
+	outIndex = positions.first->second;
+	return true;
+}
+
+const CodeFragmentList::KindIndex& CodeFragmentList::kindIndex() const
+{
+	if (!_kindIndex)
+		_kindIndex = std::make_shared<const KindIndex>(_code);
+	return *_kindIndex;
+}
+const CodeFragmentList::HashIndex& CodeFragmentList::hashIndex() const
+{
+	if (!_hashIndex)
+		_hashIndex = std::make_shared<const HashIndex>(_code);
+	return *_hashIndex;
+}
+
+std::string CodeFragmentList::toString() const
+{
+	if (_code.empty())
+		return "[]";
 
-	size_t offset = 0, len = 0, idx = 0;
+	std::stringstream ss;
+	ss << "[";
 
+	bool first = true;
 	for (const auto& c : _code)
 	{
+		if (first)
+		{
+			first = false;
+			ss << c->toString();
+		}
+		else ss << ", " << c->toString();
+	}
+
+	ss << "]";
+	return ss.str();
+}
+
+CodeFragmentList::Pointer CodeFragmentList::ptr(const size_t initialIndex) const { return { this, 0, _code.size(), initialIndex }; }
+
+
+
+CodeFragmentList::Builder::Builder(const size_t sourceLine) :
+	_front{},
+	_back{},
+	_sourceLine{ sourceLine }
+{}
+CodeFragmentList::Builder::Builder(const CodeFragmentList& list) :
+	_front{},
+	_back{ list._code },
+	_sourceLine{ list._sourceLine }
+{}
+CodeFragmentList::Builder::Builder(CodeFragmentList&& list) :
+	_front{},
+	_back{ std::move(list._code) },
+	_sourceLine{ list._sourceLine }
+{
+	list._code.clear();
+	list._kindIndex = nullptr;
+	list._hashIndex = nullptr;
+}
+CodeFragmentList::Builder::~Builder() {}
+
+size_t CodeFragmentList::Builder::size() const { return _front.size() + _back.size(); }
+bool CodeFragmentList::Builder::empty() const { return _front.empty() && _back.empty(); }
+void CodeFragmentList::Builder::reserve(const size_t size) { _back.reserve(size); }
+
+template<class _Iterator>
+void CodeFragmentList::Builder::place(const size_t index, _Iterator first, _Iterator last)
+{
+	if (index > size())
+		throw BadIndex{ index, 0, size() };
+
+	/* Inserting at a logical index i of _front is inserting at _front.size() - i of its reversed storage */
+	if (index == 0 || index < _front.size())
+		_front.insert(_front.end() - index, std::make_reverse_iterator(last), std::make_reverse_iterator(first));
+	else _back.insert(_back.begin() + (index - _front.size()), first, last);
+}
+
+CodeFragmentList::Builder& CodeFragmentList::Builder::append(const CodeFragment& code)
+{
+	_back.emplace_back(code);
+	return *this;
+}
+CodeFragmentList::Builder& CodeFragmentList::Builder::append(const CodeFragmentList& list) { return insert(size(), list); }
+CodeFragmentList::Builder& CodeFragmentList::Builder::append(CodeFragmentList&& list)
+{
+	if (!empty())
+		return insert(size(), std::move(list));
+
+	_sourceLine = std::min(_sourceLine, list._sourceLine);
+	_back = std::move(list._code);
+	list._code.clear();
+	list._kindIndex = nullptr;
+	list._hashIndex = nullptr;
+	return *this;
+}
+CodeFragmentList::Builder& CodeFragmentList::Builder::append(const CodeFragmentSpan& span) { return insert(size(), span); }
+
+CodeFragmentList::Builder& CodeFragmentList::Builder::prepend(const CodeFragment& code)
+{
+	_front.emplace_back(code);
+	return *this;
+}
+CodeFragmentList::Builder& CodeFragmentList::Builder::prepend(const CodeFragmentList& list) { return insert(0, list); }
+CodeFragmentList::Builder& CodeFragmentList::Builder::prepend(CodeFragmentList&& list) { return insert(0, std::move(list)); }
+CodeFragmentList::Builder& CodeFragmentList::Builder::prepend(const CodeFragmentSpan& span) { return insert(0, span); }
+
+CodeFragmentList::Builder& CodeFragmentList::Builder::insert(const size_t index, const CodeFragment& code)
+{
+	CloneableAllocator<CodeFragment> fragment{ code };
+	place(index, std::make_move_iterator(&fragment), std::make_move_iterator(&fragment + 1));
+	return *this;
+}
+CodeFragmentList::Builder& CodeFragmentList::Builder::insert(const size_t index, const CodeFragmentList& list)
+{
+	place(index, list._code.begin(), list._code.end());
+	_sourceLine = std::min(_sourceLine, list._sourceLine);
+	return *this;
+}
+CodeFragmentList::Builder& CodeFragmentList::Builder::insert(const size_t index, CodeFragmentList&& list)
+{
+	place(index, std::make_move_iterator(list._code.begin()), std::make_move_iterator(list._code.end()));
+	_sourceLine = std::min(_sourceLine, list._sourceLine);
+	list._code.clear();
+	list._kindIndex = nullptr;
+	list._hashIndex = nullptr;
+	return *this;
+}
+CodeFragmentList::Builder& CodeFragmentList::Builder::insert(const size_t index, const CodeFragmentSpan& span)
+{
+	if (span.empty())
+		return *this;
+	return insert(index, span.toList());
+}
+
+CodeFragmentList CodeFragmentList::Builder::freeze()
+{
+	CodeFragmentList list;
+	list._sourceLine = _sourceLine;
+	if (_front.empty())
+		list._code = std::move(_back);
+	else
+	{
+		list._code.reserve(size());
+		list._code.insert(list._code.end(), std::make_move_iterator(_front.rbegin()), std::make_move_iterator(_front.rend()));
+		list._code.insert(list._code.end(), std::make_move_iterator(_back.begin()), std::make_move_iterator(_back.end()));
+	}
+
+	_front.clear();
+	_back.clear();
+	return list;
+}
+
+
+
+CodeFragmentList::KindIndex::KindIndex(const std::vector<CloneableAllocator<CodeFragment>>& code) :
+	_kinds{ 0 },
+	_offsets{},
+	_positions(code.size())
+{
+	std::vector<uint8_t> types(code.size());
+	uint32_t counts[CODE_FRAGMENT_TYPE_COUNT] = {};
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		const CodeFragmentType type = code[i]->getCodeFragmentType();
+		types[i] = static_cast<uint8_t>(type);
+		counts[types[i]]++;
+		_kinds |= codeFragmentKind(type);
+	}
+
+	for (size_t type = 0; type < CODE_FRAGMENT_TYPE_COUNT; ++type)
+		_offsets[type + 1] = _offsets[type] + counts[type];
+
+	uint32_t next[CODE_FRAGMENT_TYPE_COUNT];
+	std::copy(_offsets, _offsets + CODE_FRAGMENT_TYPE_COUNT, next);
+	for (size_t i = 0; i < code.size(); ++i)
+		_positions[next[types[i]]++] = static_cast<uint32_t>(i);
+}
+
+CodeFragmentKinds CodeFragmentList::KindIndex::kinds() const { return _kinds; }
+bool CodeFragmentList::KindIndex::has(CodeFragmentType type) const { return (_kinds & codeFragmentKind(type)) != 0; }
+
+std::pair<const uint32_t*, const uint32_t*> CodeFragmentList::KindIndex::find(CodeFragmentType type, const size_t begin, const size_t end) const
+{
+	const uint32_t* first = _positions.data() + _offsets[static_cast<size_t>(type)];
+	const uint32_t* last = _positions.data() + _offsets[static_cast<size_t>(type) + 1];
+	if (first == last)
+		return { first, first };
+	return { std::lower_bound(first, last, begin), std::lower_bound(first, last, end) };
+}
+
+CodeFragmentList::HashIndex::HashIndex(const std::vector<CloneableAllocator<CodeFragment>>& code) :
+	_entries(code.size())
+{
+	for (size_t i = 0; i < code.size(); ++i)
+		_entries[i] = { code[i]->structuralHash(), static_cast<uint32_t>(i) };
+	std::sort(_entries.begin(), _entries.end());
+}
+
+std::pair<const std::pair<size_t, uint32_t>*, const std::pair<size_t, uint32_t>*> CodeFragmentList::HashIndex::find(size_t hash, const size_t begin, const size_t end) const
+{
+	const std::pair<size_t, uint32_t>* first = _entries.data();
+	const std::pair<size_t, uint32_t>* last = first + _entries.size();
+	const std::pair<size_t, uint32_t> from{ hash, static_cast<uint32_t>(begin) }, to{ hash, static_cast<uint32_t>(end) };
+	return { std::lower_bound(first, last, from), std::lower_bound(first, last, to) };
+}
+
+
+
+CodeFragmentList::Pointer::Pointer(const CodeFragmentList* list, const size_t begin, const size_t limit, const size_t initialValue) :
+	_list{ list },
+	_idx{ initialValue },
+	_begin{ begin },
+	_limit{ limit }
+{}
+
+const CodeFragmentList& CodeFragmentList::Pointer::list() const { return *_list; }
+
+CodeFragmentSpan CodeFragmentList::Pointer::span() const { return { *_list, _begin, _limit - _begin }; }
+
+size_t CodeFragmentList::Pointer::line() const { return _list->sourceLine(); }
+
+size_t CodeFragmentList::Pointer::index() const { return _idx - _begin; }
+
+void CodeFragmentList::Pointer::finish() { _idx = _limit; }
+
+CodeFragmentList::Pointer CodeFragmentList::Pointer::operator++ ()
+{
+	++_idx;
+	return *this;
+}
+CodeFragmentList::Pointer CodeFragmentList::Pointer::operator++ (int)
+{
+	Pointer old{ *this };
+	++_idx;
+	return old;
+}
+CodeFragmentList::Pointer CodeFragmentList::Pointer::operator-- ()
+{
+	--_idx;
+	return *this;
+}
+CodeFragmentList::Pointer CodeFragmentList::Pointer::operator-- (int)
+{
+	Pointer old{ *this };
+	--_idx;
+	return old;
+}
+
+const CodeFragment& CodeFragmentList::Pointer::operator* () const { return (*_list)[_idx]; }
+
+const CodeFragment* CodeFragmentList::Pointer::operator-> () const { return &(*_list)[_idx]; }
+
+CodeFragmentList::Pointer::operator bool() const { return _idx < _limit; }
+bool CodeFragmentList::Pointer::operator! () const { return _idx >= _limit; }
+
+
+
+
+
+
+CodeFragmentSpan::CodeFragmentSpan() :
+	_list{ nullptr },
+	_offset{ 0 },
+	_length{ 0 }
+{}
+CodeFragmentSpan::CodeFragmentSpan(const CodeFragmentList& list) :
+	_list{ &list },
+	_offset{ 0 },
+	_length{ list.size() }
+{}
+CodeFragmentSpan::CodeFragmentSpan(const CodeFragmentList& list, const size_t off, const size_t len) :
+	_list{ &list },
+	_offset{ off },
+	_length{ len }
+{
+	if (off + len > list.size())
+		throw BadIndex{ off + len, 0, list.size() };
+}
+CodeFragmentSpan::~CodeFragmentSpan() {}
+
+size_t CodeFragmentSpan::size() const { return _length; }
+bool CodeFragmentSpan::empty() const { return _length == 0; }
+CodeFragmentSpan::operator bool() const { return _length != 0; }
+bool CodeFragmentSpan::operator! () const { return _length == 0; }
+
+size_t CodeFragmentSpan::sourceLine() const { return _list ? _list->sourceLine() : 0; }
+
+const CodeFragment& CodeFragmentSpan::get(const size_t index) const
+{
+	if (index >= _length)
+		throw BadIndex{ index, 0, _length };
+	return (*_list)[_offset + index];
+}
+const CodeFragment& CodeFragmentSpan::operator[] (const size_t index) const { return (*_list)[_offset + index]; }
+
+CodeFragmentSpan CodeFragmentSpan::subspan(const size_t off, const size_t len) const
+{
+	if (off + len > _length)
+		throw BadIndex{ off + len, 0, _length };
+	return { *_list, _offset + off, len };
+}
+CodeFragmentSpan CodeFragmentSpan::subspan(const size_t off) const { return subspan(off, _length - off); }
+
+CodeFragmentList CodeFragmentSpan::toList() const
+{
+	if (!_list)
+		return {};
+	return { _list->sourceLine(), _list->code(), _offset, _length };
+}
+
+CodeFragmentSpan CodeFragmentSpan::extract(const CodeFragment& from, const CodeFragment& to) const
+{
+	bool init = false;
+
+	size_t offset = 0, len = 0;
+
+	for (size_t idx = 0; idx < _length; ++idx)
+	{
+		const CodeFragment& c = operator[](idx);
 		if (!init)
 		{
-			if (c == from)
+			if (c.structuralHash() == from.structuralHash() && c == from)
 			{
 				init = true;
 				offset = idx;
 			}
-			++idx;
 		}
 		else
 		{
-			if (c == to)
+			if (c.structuralHash() == to.structuralHash() && c == to)
 				break;
 			++len;
 		}
@@ -1575,172 +2271,143 @@ CodeFragmentList CodeFragmentList::extract(const CodeFragment& from, const CodeF
 
 	if (!init)
 		return {};
-	return sublist(offset, len);
+	return subspan(offset, len);
 }
 
-size_t CodeFragmentList::count(const CodeFragment& code) const
+size_t CodeFragmentSpan::count(const CodeFragment& code) const
 {
+	if (!_length)
+		return 0;
+
 	size_t count = 0;
-	for (const auto& cf : _code)
-		if (cf == code)
+	auto candidates = _list->hashIndex().find(code.structuralHash(), _offset, _offset + _length);
+	for (auto it = candidates.first; it != candidates.second; ++it)
+		if (_list->get(it->second) == code)
 			++count;
 	return count;
 }
 
-size_t CodeFragmentList::count(CodeFragmentType codeType) const
+size_t CodeFragmentSpan::count(CodeFragmentType codeType) const
 {
-	size_t count = 0;
-	for (const auto& cf : _code)
-		if (cf->getCodeFragmentType() == codeType)
-			++count;
-	return count;
+	if (!_length)
+		return 0;
+
+	auto positions = _list->kindIndex().find(codeType, _offset, _offset + _length);
+	return static_cast<size_t>(positions.second - positions.first);
 }
 
-bool CodeFragmentList::has(const CodeFragment& code) const
+bool CodeFragmentSpan::has(const CodeFragment& code) const
 {
-	for (const auto& cf : _code)
-		if (cf == code)
-			return true;
-	return false;
+	size_t index;
+	return indexOf(code, index);
 }
-bool CodeFragmentList::has(CodeFragmentType codeType) const
+bool CodeFragmentSpan::has(CodeFragmentType codeType) const
 {
-	for (const auto& cf : _code)
-		if (cf->getCodeFragmentType() == codeType)
-			return true;
-	return false;
+	if (!_length)
+		return false;
+
+	auto positions = _list->kindIndex().find(codeType, _offset, _offset + _length);
+	return positions.first != positions.second;
 }
 
-bool CodeFragmentList::indexOf(const CodeFragment& code, size_t& outIndex) const
+bool CodeFragmentSpan::indexOf(const CodeFragment& code, size_t& outIndex) const
 {
-	size_t index = 0;
-	for (const auto& cf : _code)
+	if (!_length)
+		return false;
+
+	auto candidates = _list->hashIndex().find(code.structuralHash(), _offset, _offset + _length);
+	for (auto it = candidates.first; it != candidates.second; ++it)
 	{
-		if (cf == code)
+		if (_list->get(it->second) == code)
 		{
-			outIndex = index;
+			outIndex = it->second - _offset;
 			return true;
 		}
-		++index;
 	}
 	return false;
 }
-bool CodeFragmentList::indexOf(CodeFragmentType codeType, size_t& outIndex) const
+bool CodeFragmentSpan::indexOf(CodeFragmentType codeType, size_t& outIndex) const
 {
-	size_t index = 0;
-	for (const auto& cf : _code)
-	{
-		if (cf->getCodeFragmentType() == codeType)
-		{
-			outIndex = index;
-			return true;
-		}
-		++index;
-	}
-	return false;
+	if (!_length)
+		return false;
+
+	auto positions = _list->kindIndex().find(codeType, _offset, _offset + _length);
+	if (positions.first == positions.second)
+		return false;
+
+	outIndex = *positions.first - _offset;
+	return true;
 }
 
-bool CodeFragmentList::lastIndexOf(const CodeFragment& code, size_t& outIndex) const
+bool CodeFragmentSpan::lastIndexOf(const CodeFragment& code, size_t& outIndex) const
 {
-	bool found = false;
-	size_t index = 0;
-	for (const auto& cf : _code)
+	if (!_length)
+		return false;
+
+	auto candidates = _list->hashIndex().find(code.structuralHash(), _offset, _offset + _length);
+	for (auto it = candidates.second; it != candidates.first;)
 	{
-		if (cf == code)
+		if (_list->get((--it)->second) == code)
 		{
-			outIndex = index;
-			found = true;
+			outIndex = it->second - _offset;
+			return true;
 		}
-		++index;
 	}
-	return found;
+	return false;
 }
-bool CodeFragmentList::lastIndexOf(CodeFragmentType codeType, size_t& outIndex) const
+bool CodeFragmentSpan::lastIndexOf(CodeFragmentType codeType, size_t& outIndex) const
 {
-	bool found = false;
-	size_t index = 0;
-	for (const auto& cf : _code)
-	{
-		if (cf->getCodeFragmentType() == codeType)
-		{
-			outIndex = index;
-			found = true;
-		}
-		++index;
-	}
-	return found;
+	if (!_length)
+		return false;
+
+	auto positions = _list->kindIndex().find(codeType, _offset, _offset + _length);
+	if (positions.first == positions.second)
+		return false;
+
+	outIndex = *(positions.second - 1) - _offset;
+	return true;
 }
 
-std::vector<CodeFragmentList> CodeFragmentList::split(const CodeFragment& separator, int limit) const
+std::vector<CodeFragmentSpan> CodeFragmentSpan::split(const CodeFragment& separator, int limit) const
 {
-	if (_code.empty() || limit == 1)
+	if (_length == 0 || limit == 1)
 		return { *this };
 
 	limit = limit < 1 ? -1 : limit;
-	std::vector<CodeFragmentList> parts;
+	std::vector<CodeFragmentSpan> parts;
 
+	const size_t hash = separator.structuralHash();
 	size_t i, off;
-	for (i = 0, off = 0; i < _code.size(); i++)
-		if (_code[i] == separator && limit != 0)
+	for (i = 0, off = 0; i < _length; i++)
+		if (limit != 0 && operator[](i).structuralHash() == hash && operator[](i) == separator)
 		{
-			parts.push_back(sublist(off, i - off));
+			parts.push_back(subspan(off, i - off));
 			off = i + 1;
 			--limit;
 		}
 	if (i > off)
-		parts.push_back(sublist(off, i - off));
-	return std::move(parts);
+		parts.push_back(subspan(off, i - off));
+	return parts;
 }
 
-std::string CodeFragmentList::toString() const
+std::string CodeFragmentSpan::toString() const
 {
-	if (_code.empty())
+	if (_length == 0)
 		return "[]";
 
 	std::stringstream ss;
 	ss << "[";
-
-	bool first = true;
-	for (const auto& c : _code)
+	for (size_t i = 0; i < _length; ++i)
 	{
-		if (first)
-		{
-			first = false;
-			ss << c->toString();
-		}
-		else ss << ", " << c->toString();
+		if (i > 0)
+			ss << ", ";
+		ss << operator[](i).toString();
 	}
-
 	ss << "]";
 	return ss.str();
 }
 
-CodeFragmentList::Pointer CodeFragmentList::ptr(const size_t initialIndex) const { return { this, initialIndex }; }
-
-
-
-CodeFragmentList::Pointer::Pointer(const CodeFragmentList* list, const size_t initialValue) :
-	_list{ list },
-	_idx{ initialValue },
-	_limit{ list->size() }
-{}
-
-const CodeFragmentList& CodeFragmentList::Pointer::list() const { return *_list; }
-
-size_t CodeFragmentList::Pointer::line() const { return _list->sourceLine(); }
-
-size_t CodeFragmentList::Pointer::index() const { return _idx; }
-
-void CodeFragmentList::Pointer::finish() { _idx = _limit; }
-
-CodeFragmentList::Pointer CodeFragmentList::Pointer::operator++ () { return { _list, ++_idx }; }
-CodeFragmentList::Pointer CodeFragmentList::Pointer::operator++ (int) { return { _list, _idx++ }; }
-CodeFragmentList::Pointer CodeFragmentList::Pointer::operator-- () { return { _list, --_idx }; }
-CodeFragmentList::Pointer CodeFragmentList::Pointer::operator-- (int) { return { _list, _idx-- }; }
-
-const CodeFragment& CodeFragmentList::Pointer::operator* () const { return (*_list)[_idx]; }
-
-const CodeFragment* CodeFragmentList::Pointer::operator-> () const { return &(*_list)[_idx]; }
-
-CodeFragmentList::Pointer::operator bool() const { return _idx < _limit; }
-bool CodeFragmentList::Pointer::operator! () const { return _idx >= _limit; }
+CodeFragmentList::Pointer CodeFragmentSpan::ptr(const size_t initialIndex) const
+{
+	return { _list, _offset, _offset + _length, _offset + initialIndex };
+}
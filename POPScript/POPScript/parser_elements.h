@@ -1,9 +1,11 @@
 #pragma once
 
 #include <type_traits>
-#include <regex>
+#include <memory>
 
 #include "types.h"
+#include "symbols.h"
+#include "arena.h"
 #include "utils.h"
 #include "functions.h"
 
@@ -23,13 +25,35 @@ enum class CodeFragmentType
 	Scope,
 };
 
+constexpr size_t CODE_FRAGMENT_TYPE_COUNT = static_cast<size_t>(CodeFragmentType::Scope) + 1;
+
+/* Set of CodeFragmentTypes, one bit per type */
+typedef uint16_t CodeFragmentKinds;
+
+static_assert(CODE_FRAGMENT_TYPE_COUNT <= sizeof(CodeFragmentKinds) * 8);
+
+constexpr CodeFragmentKinds codeFragmentKind(CodeFragmentType type) { return static_cast<CodeFragmentKinds>(1U << static_cast<unsigned int>(type)); }
+
 
 
 class CodeFragment : public Cloneable, public Conversor<CodeFragment>
 {
+private:
+	/* Hash of the kind and contents of the subtree, set when the node is built. Equal fragments hash equal. */
+	size_t _hash = 0;
+
+protected:
+	inline void setStructuralHash(size_t hash) { _hash = hash; }
+
 public:
 	virtual ~CodeFragment() {}
 
+	/* Nodes are taken from the current NodeArena, if any */
+	static inline void* operator new(size_t size) { return NodeArena::allocateNode(size); }
+	static inline void operator delete(void* ptr, size_t size) { NodeArena::releaseNode(ptr, size); }
+
+	inline size_t structuralHash() const { return _hash; }
+
 	virtual CodeFragmentType getCodeFragmentType() const = 0;
 
 	virtual bool isStatement() const = 0;
@@ -45,21 +69,14 @@ public:
 
 
 	bool is(CodeFragmentType type) const;
+	bool isAny(CodeFragmentKinds kinds) const;
 
 	template<typename... _Args>
 	bool is(CodeFragmentType t0, _Args&&... args) const
 	{
-		static_assert(std::is_convertible<_Args, CodeFragmentType>::value);
-
-		auto type = getCodeFragmentType();
-		if (type == t0)
-			return true;
+		static_assert((std::is_convertible<_Args, CodeFragmentType>::value && ...));
 
-		std::vector<CodeFragmentType> vargs = { static_cast<CodeFragmentType&&>(args)... };
-		for (auto t : vargs)
-			if (type == t)
-				return true;
-		return false;
+		return isAny(static_cast<CodeFragmentKinds>((codeFragmentKind(t0) | ... | codeFragmentKind(static_cast<CodeFragmentType>(args)))));
 	}
 };
 
@@ -83,10 +100,12 @@ public:
 	class InvalidIdentifier : public std::exception {};
 
 private:
-	std::string _id;
+	Symbol _id;
+	const SymbolTable* _table;
 
 public:
 	Identifier(const std::string& identifier);
+	Identifier(Symbol symbol, const SymbolTable& table);
 	Identifier(const Identifier& id);
 	Identifier(Identifier&& id) noexcept;
 	~Identifier();
@@ -94,6 +113,9 @@ public:
 	Identifier& operator= (const Identifier& id);
 	Identifier& operator= (Identifier&& id) noexcept;
 
+	Symbol getSymbol() const;
+	std::string_view getName() const;
+
 	CodeFragmentType getCodeFragmentType() const override;
 
 	std::string toString(size_t identation = 0) const override;
@@ -104,17 +126,18 @@ public:
 	bool operator== (const Identifier& id) const;
 	bool operator!= (const Identifier& id) const;
 
-private:
-	static const std::regex _pattern;
-
 public:
 	static bool isValid(const std::string& str);
+	static bool isValid(const char* begin, const char* end);
 };
 
 
 
 class LiteralInteger : public Statement
 {
+public:
+	class InvalidLiteral : public std::exception {};
+
 private:
 	FieldValue _value;
 
@@ -139,12 +162,12 @@ public:
 	bool operator== (const LiteralInteger& lit) const;
 	bool operator!= (const LiteralInteger& lit) const;
 
-private:
-	static const std::regex _pattern;
-
 public:
 	static LiteralInteger parse(const std::string& str);
 	static bool isValid(const std::string& str);
+
+	/* Decimal "0|[1-9][0-9]*", octal "0[0-7]+" or hex "0[xX][0-9a-fA-F]+", up to INT32_MAX */
+	static bool tryParse(const char* begin, const char* end, FieldValue& value);
 };
 
 
@@ -266,6 +289,8 @@ public:
 	FunctionArguments& operator= (const FunctionArguments& a);
 	FunctionArguments& operator= (FunctionArguments&& a) noexcept;
 
+	void addArgument(const Statement& arg);
+
 	CodeFragmentType getCodeFragmentType() const override;
 
 	std::string toString(size_t identation = 0) const override;
@@ -290,6 +315,8 @@ public:
 	CommandArguments& operator= (const CommandArguments& a);
 	CommandArguments& operator= (CommandArguments&& a) noexcept;
 
+	void addArgument(const Statement& arg);
+
 	CodeFragmentType getCodeFragmentType() const override;
 
 	bool isStatement() const override;
@@ -308,7 +335,7 @@ public:
 class Operator : public CodeFragment
 {
 public:
-	enum class Type
+	enum class Type : uint8_t
 	{
 		Unary,
 		Binary,
@@ -316,15 +343,49 @@ public:
 		Assignment
 	};
 
+	/* Index of the operator in the operator table */
+	enum class Id : uint8_t
+	{
+		SufixIncrement,
+		SufixDecrement,
+
+		PrefixIncrement,
+		PrefixDecrement,
+		UnaryMinus,
+		BinaryNot,
+
+		Multiplication,
+		Division,
+
+		Addition,
+		Subtraction,
+
+		GreaterThan,
+		SmallerThan,
+		GreaterEqualsThan,
+		SmallerEqualsThan,
+
+		EqualsTo,
+		NotEqualsTo,
+
+		BinaryAnd,
+		BinaryOr,
+
+		TernaryConditional,
+
+		Assignment,
+		AssignmentAddition,
+		AssignmentSubtraction,
+		AssignmentMultiplication,
+		AssignmentDivision
+	};
+
+	static constexpr size_t COUNT = static_cast<size_t>(Id::AssignmentDivision) + 1;
+
 private:
-	uint8_t _id;
-	std::string _symbol;
-	Type _type;
-	unsigned int _priority;
-	bool _rightToLeft;
-	bool _conditional;
+	Id _id;
 
-	Operator(const std::string& symbol, const Type type, unsigned int priority, bool rightToLeft, bool conditional);
+	Operator(Id id);
 
 public:
 	Operator(const Operator& op);
@@ -334,6 +395,10 @@ public:
 	Operator& operator= (const Operator& op);
 	Operator& operator= (Operator&& op) noexcept;
 
+	Id getId() const;
+	const char* getSymbol() const;
+	Type getType() const;
+
 	unsigned int getPriority() const;
 	bool hasRightToLeft() const;
 	bool isConditional() const;
@@ -390,6 +455,8 @@ public:
 	static const Operator AssignmentSubtraction;
 	static const Operator AssignmentMultiplication;
 	static const Operator AssignmentDivision;
+
+	static const Operator& get(Id id);
 };
 
 
@@ -404,7 +471,7 @@ public:
 	};
 
 private:
-	Operator _operator;
+	Operator::Id _operator;
 	CloneableAllocator<Statement> _operands[3];
 
 public:
@@ -539,6 +606,9 @@ public:
 	static const Command If;
 	static const Command Else;
 	static const Command Every;
+
+	static const Command* find(const std::string& name);
+	static const Command* find(const char* name, size_t length);
 };
 
 
@@ -876,12 +946,53 @@ public:
 
 
 
+class CodeFragmentSpan;
+
 class CodeFragmentList
 {
+public:
+	/* Positions of the fragments of each type, in ascending order */
+	class KindIndex
+	{
+	private:
+		CodeFragmentKinds _kinds;
+		uint32_t _offsets[CODE_FRAGMENT_TYPE_COUNT + 1];
+		std::vector<uint32_t> _positions;
+
+	public:
+		KindIndex(const std::vector<CloneableAllocator<CodeFragment>>& code);
+
+		CodeFragmentKinds kinds() const;
+		bool has(CodeFragmentType type) const;
+
+		/* Positions of the fragments of type in [begin, end) */
+		std::pair<const uint32_t*, const uint32_t*> find(CodeFragmentType type, const size_t begin, const size_t end) const;
+	};
+
+	/* Positions of the fragments sorted by structural hash */
+	class HashIndex
+	{
+	private:
+		std::vector<std::pair<size_t, uint32_t>> _entries;
+
+	public:
+		HashIndex(const std::vector<CloneableAllocator<CodeFragment>>& code);
+
+		/* Positions in [begin, end) of the fragments with the given hash, ascending */
+		std::pair<const std::pair<size_t, uint32_t>*, const std::pair<size_t, uint32_t>*> find(size_t hash, const size_t begin, const size_t end) const;
+	};
+
 private:
 	std::vector<CloneableAllocator<CodeFragment>> _code;
 	size_t _sourceLine;
 
+	/*
+	 * Built by the first query that needs them and dropped by set(), the only way to change a fragment:
+	 * fragments are only handed out as const. Copies of the list share them.
+	 */
+	mutable std::shared_ptr<const KindIndex> _kindIndex;
+	mutable std::shared_ptr<const HashIndex> _hashIndex;
+
 public:
 	CodeFragmentList();
 	explicit CodeFragmentList(const size_t sourceLine, const CodeFragment& cf);
@@ -908,7 +1019,6 @@ public:
 	void set(const size_t index, const CodeFragment& code);
 	const CodeFragment& get(const size_t index) const;
 
-	CodeFragment& operator[] (const size_t index);
 	const CodeFragment& operator[] (const size_t index) const;
 
 
@@ -919,6 +1029,11 @@ public:
 	CodeFragmentList sublist(const size_t off, const size_t len) const;
 	CodeFragmentList sublist(const size_t off) const;
 
+	/* Views that copy nothing. They are valid while the list lives and is not modified. */
+	CodeFragmentSpan span() const;
+	CodeFragmentSpan span(const size_t off, const size_t len) const;
+	CodeFragmentSpan span(const size_t off) const;
+
 	CodeFragmentList concat(const CodeFragmentList& fl) const;
 	inline CodeFragmentList concat(const CodeFragment& code) const { return concat(CodeFragmentList{ _sourceLine, code }); }
 	inline CodeFragmentList concat(const std::vector<CodeFragment*>& code) const { return concat(CodeFragmentList{ _sourceLine, code }); }
@@ -931,11 +1046,11 @@ public:
 	friend CodeFragmentList operator+ (const CodeFragmentList& fl, const std::vector<CloneableAllocator<CodeFragment>>& code);
 	friend CodeFragmentList operator+ (const CodeFragmentList& fl, const CloneableVector<CodeFragment>& code);
 
-	inline CodeFragmentList& operator+= (const CodeFragmentList& fl) { return operator=(concat(fl)); }
-	inline CodeFragmentList& operator+= (const CodeFragment& code) { return operator=(concat(code)); }
-	inline CodeFragmentList& operator+= (const std::vector <CodeFragment*>& code) { return operator=(concat(code)); }
-	inline CodeFragmentList& operator+= (const std::vector<CloneableAllocator<CodeFragment>>& code) { return operator=(concat(code)); }
-	inline CodeFragmentList& operator+= (const CloneableVector<CodeFragment>& code) { return operator=(concat(code)); }
+	CodeFragmentList& operator+= (const CodeFragmentList& fl);
+	CodeFragmentList& operator+= (const CodeFragment& code);
+	inline CodeFragmentList& operator+= (const std::vector <CodeFragment*>& code) { return operator+=(CodeFragmentList{ _sourceLine, code }); }
+	inline CodeFragmentList& operator+= (const std::vector<CloneableAllocator<CodeFragment>>& code) { return operator+=(CodeFragmentList{ _sourceLine, code }); }
+	inline CodeFragmentList& operator+= (const CloneableVector<CodeFragment>& code) { return operator+=(CodeFragmentList{ _sourceLine, code }); }
 
 	inline CodeFragmentList concatFirst(const CodeFragmentList& fl) const { return fl.concat(*this); }
 	inline CodeFragmentList concatFirst(const CodeFragment& code) const { return concatFirst(CodeFragmentList{ _sourceLine, code }); }
@@ -954,7 +1069,7 @@ public:
 	inline CodeFragmentList concatMiddle(const size_t index, const std::vector<CloneableAllocator<CodeFragment>>& code) const { return concatMiddle(index, CodeFragmentList{ _sourceLine, code }); }
 	inline CodeFragmentList concatMiddle(const size_t index, const CloneableVector<CodeFragment>& code) const { return concatMiddle(index, CodeFragmentList{ _sourceLine, code }); }
 
-	inline CodeFragmentList wrapBetween(const CodeFragmentList& before, const CodeFragmentList& after) const { return before.concat(*this).concat(after); }
+	CodeFragmentList wrapBetween(const CodeFragmentList& before, const CodeFragmentList& after) const;
 	inline CodeFragmentList wrapBetween(const CodeFragment& before, const CodeFragment& after) const { return wrapBetween(CodeFragmentList{ _sourceLine, before }, CodeFragmentList{ _sourceLine, after }); }
 	inline CodeFragmentList wrapBetween(const std::vector<CodeFragment*>& before, const std::vector<CodeFragment*>& after) const {
 		return wrapBetween(CodeFragmentList{ _sourceLine, before }, CodeFragmentList{ _sourceLine, after });
@@ -982,6 +1097,12 @@ public:
 
 	std::vector<CodeFragmentList> split(const CodeFragment& separator, int limit = -1) const;
 
+	/* Position of the first fragment with the given structural hash */
+	bool indexOfHash(size_t hash, size_t& outIndex) const;
+
+	const KindIndex& kindIndex() const;
+	const HashIndex& hashIndex() const;
+
 	std::string toString() const;
 
 public:
@@ -989,13 +1110,15 @@ public:
 	{
 	public:
 		friend class CodeFragmentList;
+		friend class CodeFragmentSpan;
 
 	private:
 		const CodeFragmentList* _list;
 		size_t _idx;
+		size_t _begin;
 		size_t _limit;
 
-		Pointer(const CodeFragmentList* list, const size_t initialValue = 0);
+		Pointer(const CodeFragmentList* list, const size_t begin, const size_t limit, const size_t initialValue);
 
 	public:
 		Pointer(const Pointer&) = default;
@@ -1006,6 +1129,9 @@ public:
 
 		const CodeFragmentList& list() const;
 
+		/* Range this pointer walks. index() is relative to it. */
+		CodeFragmentSpan span() const;
+
 		size_t line() const;
 
 		size_t index() const;
@@ -1026,5 +1152,111 @@ public:
 	};
 
 	Pointer ptr(const size_t initialIndex = 0) const;
+
+public:
+	/*
+	 * Grows a list in place and hands it over with freeze(). Appending and prepending are amortized O(1) per fragment,
+	 * and fragments of rvalue lists are moved instead of shared. Like concat, the source line is the lowest one seen.
+	 */
+	class Builder
+	{
+	private:
+		/* Prepended fragments are kept reversed so both ends grow at the back of a vector */
+		std::vector<CloneableAllocator<CodeFragment>> _front;
+		std::vector<CloneableAllocator<CodeFragment>> _back;
+		size_t _sourceLine;
+
+	public:
+		explicit Builder(const size_t sourceLine = 0);
+		Builder(const CodeFragmentList& list);
+		Builder(CodeFragmentList&& list);
+		Builder(const Builder&) = default;
+		Builder(Builder&&) noexcept = default;
+		~Builder();
+
+		Builder& operator= (const Builder&) = default;
+		Builder& operator= (Builder&&) noexcept = default;
+
+		size_t size() const;
+		bool empty() const;
+		void reserve(const size_t size);
+
+		Builder& append(const CodeFragment& code);
+		Builder& append(const CodeFragmentList& list);
+		Builder& append(CodeFragmentList&& list);
+		Builder& append(const CodeFragmentSpan& span);
+
+		Builder& prepend(const CodeFragment& code);
+		Builder& prepend(const CodeFragmentList& list);
+		Builder& prepend(CodeFragmentList&& list);
+		Builder& prepend(const CodeFragmentSpan& span);
+
+		Builder& insert(const size_t index, const CodeFragment& code);
+		Builder& insert(const size_t index, const CodeFragmentList& list);
+		Builder& insert(const size_t index, CodeFragmentList&& list);
+		Builder& insert(const size_t index, const CodeFragmentSpan& span);
+
+		/* Moves the fragments into a list and leaves the builder empty */
+		CodeFragmentList freeze();
+
+	private:
+		template<class _Iterator>
+		void place(const size_t index, _Iterator first, _Iterator last);
+	};
+};
+
+
+
+class CodeFragmentSpan
+{
+private:
+	const CodeFragmentList* _list;
+	size_t _offset;
+	size_t _length;
+
+public:
+	CodeFragmentSpan();
+	CodeFragmentSpan(const CodeFragmentList& list);
+	CodeFragmentSpan(const CodeFragmentList& list, const size_t off, const size_t len);
+	CodeFragmentSpan(const CodeFragmentSpan&) = default;
+	~CodeFragmentSpan();
+
+	CodeFragmentSpan& operator= (const CodeFragmentSpan&) = default;
+
+	size_t size() const;
+	bool empty() const;
+	operator bool() const;
+	bool operator! () const;
+
+	size_t sourceLine() const;
+
+	const CodeFragment& get(const size_t index) const;
+	const CodeFragment& operator[] (const size_t index) const;
+
+	CodeFragmentSpan subspan(const size_t off, const size_t len) const;
+	CodeFragmentSpan subspan(const size_t off) const;
+
+	/* Owning copy of the viewed fragments */
+	CodeFragmentList toList() const;
+
+	CodeFragmentSpan extract(const CodeFragment& from, const CodeFragment& to) const;
+
+	size_t count(const CodeFragment& code) const;
+	size_t count(CodeFragmentType codeType) const;
+
+	bool has(const CodeFragment& code) const;
+	bool has(CodeFragmentType codeType) const;
+
+	bool indexOf(const CodeFragment& code, size_t& outIndex) const;
+	bool indexOf(CodeFragmentType codeType, size_t& outIndex) const;
+
+	bool lastIndexOf(const CodeFragment& code, size_t& outIndex) const;
+	bool lastIndexOf(CodeFragmentType codeType, size_t& outIndex) const;
+
+	std::vector<CodeFragmentSpan> split(const CodeFragment& separator, int limit = -1) const;
+
+	std::string toString() const;
+
+	CodeFragmentList::Pointer ptr(const size_t initialIndex = 0) const;
 };
 
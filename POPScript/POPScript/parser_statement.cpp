@@ -1,31 +1,340 @@
 #include "parser.h"
+#include "hashcons.h"
+#include "spans.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/*
+ * Both statement parsers share one operator precedence parser that keeps its state in heap stacks instead of
+ * recursing: pending operators, groups and ternaries are frames, and a frame is reduced once an incoming operator
+ * binds looser than it (higher priority number), or as loose if it goes left to right. A ternary false case runs
+ * to the end of the enclosing expression. The frame count is bounded by the nesting limit.
+ */
+
+
+namespace parser::statement::climb
+{
+    typedef CloneableAllocator<Statement> StatementAlloc;
+
+    enum class FrameKind
+    {
+        Prefix,
+        Binary,
+        Condition,
+        Alternative,
+        Group
+    };
+
+    struct Frame
+    {
+        FrameKind kind;
+        const Operator* oper;
+        size_t first;
+    };
+
+    /* The node may be shared by other occurrences; source is the occurrence of this one, if spans are recorded */
+    struct Operand
+    {
+        StatementAlloc node;
+        size_t first;
+        NodeId source;
+    };
+
+    /* Canonical node equal to node if statements are being shared, node itself otherwise */
+    static StatementAlloc shared(const StatementAlloc& node)
+    {
+        StatementTable* table = StatementTable::current();
+        return table ? table->intern(node) : node;
+    }
+
+    /*
+     * _Source walks one statement and provides: end, position, next, text, error, isOperator, prefix, sufix,
+     * infix, isOpenGroup, isCloseGroup, isTernarySeparator, operand and located. located records the occurrence
+     * that spans from first to the current position, with the occurrences of its operands.
+     */
+    template<class _Source>
+    class Climber
+    {
+    private:
+        _Source& _src;
+        size_t _maxNesting;
+        std::vector<Frame> _frames;
+        std::vector<Operand> _operands;
+
+    public:
+        Climber(_Source& src, size_t maxNesting) :
+            _src{ src },
+            _maxNesting{ maxNesting },
+            _frames{},
+            _operands{}
+        {}
+
+        StatementAlloc parse()
+        {
+            do packOperand();
+            while (packOperator());
+
+            while (!_frames.empty())
+            {
+                if (_frames.back().kind == FrameKind::Group)
+                    throw _src.error("Expected a )");
+                if (_frames.back().kind == FrameKind::Condition)
+                    throw _src.error("Expected a : in ternary operator");
+                reduce();
+            }
+
+            if (!_src.end())
+                throw _src.error("Expected a valid operator between operands. \"" + _src.text() + "\"");
+            return std::move(_operands.back().node);
+        }
+
+    private:
+        void push(FrameKind kind, const Operator* oper, size_t first)
+        {
+            if (_frames.size() >= _maxNesting)
+                throw _src.error("Statement nested deeper than " + std::to_string(_maxNesting) + " levels");
+            _frames.push_back({ kind, oper, first });
+        }
+
+        /* Prefix operators and open groups, then one operand with its sufix operators */
+        void packOperand()
+        {
+            for (;;)
+            {
+                if (_src.end())
+                    throw _src.error("Unexpected end of instruction");
+
+                if (_src.isOpenGroup())
+                {
+                    push(FrameKind::Group, nullptr, _src.position());
+                    _src.next();
+                    if (!_src.end() && _src.isCloseGroup())
+                        throw _src.error("Expected valid operand. But found: ()");
+                }
+                else if (_src.isOperator())
+                {
+                    const Operator* prefix = _src.prefix();
+                    if (!prefix)
+                        throw _src.error("Operator " + _src.text() + " cannot be a non unary prefix operator");
+
+                    push(FrameKind::Prefix, prefix, _src.position());
+                    _src.next();
+                    if (_src.end())
+                        throw _src.error("unexpected end of instruction");
+                }
+                else break;
+            }
+
+            const size_t first = _src.position();
+            StatementAlloc node = shared(_src.operand());
+            _operands.push_back({ std::move(node), first, _src.located(first) });
+            packSufixes();
+        }
+
+        void packSufixes()
+        {
+            Operand& top = _operands.back();
+            while (!_src.end())
+            {
+                const Operator* sufix = _src.sufix();
+                if (!sufix)
+                    break;
+
+                _src.next();
+                top.node = shared(Operation::unary(*sufix, top.node));
+                top.source = _src.located(top.first, top.source);
+            }
+
+            while (!_frames.empty() && _frames.back().kind == FrameKind::Prefix)
+                reduce();
+        }
+
+        /* Consumes the next operator, closing groups and ternary conditions on the way. False at the end of the statement. */
+        bool packOperator()
+        {
+            for (;;)
+            {
+                if (_src.end())
+                    return false;
+
+                if (_src.isCloseGroup())
+                {
+                    if (!reduceTo(FrameKind::Group))
+                        return false;
+
+                    _operands.back().first = _frames.back().first;
+                    _frames.pop_back();
+                    _src.next();
+                    packSufixes();
+                }
+                else if (_src.isTernarySeparator())
+                {
+                    if (!reduceTo(FrameKind::Condition))
+                        return false;
+
+                    _frames.back().kind = FrameKind::Alternative;
+                    _src.next();
+                    return true;
+                }
+                else break;
+            }
+
+            const Operator* oper = _src.infix();
+            if (!oper)
+                return false;
+
+            while (!_frames.empty() && _frames.back().kind == FrameKind::Binary && bindsFirst(*_frames.back().oper, *oper))
+                reduce();
+
+            const size_t first = _operands.back().first;
+            if (oper->isTernary())
+                push(FrameKind::Condition, oper, first);
+            else if (oper->isBinary() || oper->isAssignment())
+                push(FrameKind::Binary, oper, first);
+            else throw _src.error("Invalid operator type: " + oper->toString());
+
+            _src.next();
+            return true;
+        }
+
+        static bool bindsFirst(const Operator& pending, const Operator& incoming)
+        {
+            return pending.comparePriority(incoming) >= 0;
+        }
+
+        /* Reduces until a frame of the given kind is on top. False if a group or condition is in the way. */
+        bool reduceTo(FrameKind kind)
+        {
+            while (!_frames.empty())
+            {
+                const FrameKind top = _frames.back().kind;
+                if (top == kind)
+                    return true;
+                if (top == FrameKind::Group)
+                    return false;
+                if (top == FrameKind::Condition)
+                    throw _src.error("Expected a : in ternary operator");
+                reduce();
+            }
+            return false;
+        }
+
+        void reduce()
+        {
+            const Frame frame = _frames.back();
+            _frames.pop_back();
+
+            switch (frame.kind)
+            {
+                case FrameKind::Prefix: {
+                    Operand& operand = _operands.back();
+                    operand.node = shared(Operation::unary(*frame.oper, operand.node));
+                    operand.source = _src.located(frame.first, operand.source);
+                    operand.first = frame.first;
+                } break;
+
+                case FrameKind::Binary: {
+                    const Operand right = std::move(_operands.back());
+                    _operands.pop_back();
+
+                    Operand& left = _operands.back();
+                    if (frame.oper->isBinary())
+                        left.node = shared(Operation::binary(*frame.oper, left.node, right.node));
+                    else left.node = shared(Operation::assignment(*frame.oper, left.node, right.node));
+                    left.source = _src.located(left.first, left.source, right.source);
+                } break;
+
+                case FrameKind::Alternative: {
+                    const Operand response2 = std::move(_operands.back());
+                    _operands.pop_back();
+                    const Operand response1 = std::move(_operands.back());
+                    _operands.pop_back();
+
+                    Operand& condition = _operands.back();
+                    condition.node = shared(Operation::ternary(condition.node, response1.node, response2.node));
+                    condition.source = _src.located(condition.first, condition.source, response1.source, response2.source);
+                } break;
+
+                default:
+                    throw IllegalState{ "Groups and ternary conditions are not reducible" };
+            }
+        }
+    };
+}
+
+
+
 
 
 namespace parser::statement::impl
 {
-    typedef CloneableAllocator<CodeFragment> CodeFragmentAlloc;
     typedef CloneableAllocator<Statement> StatementAlloc;
     typedef CodeFragmentList::Pointer Ptr;
 
-    static StatementAlloc packPart(Ptr& it);
-    static StatementAlloc packPreUnary(Ptr& it);
-    static StatementAlloc packPostUnary(Ptr& it, const Statement& pre);
-    static const Operator* findNextOperatorSymbol(const CodeFragmentList& list, size_t index);
-    static StatementAlloc getSuperOperatorScope(Ptr& it, const Operator& base);
-    static StatementAlloc packOperation(Ptr& it, const Statement& operand1);
-    static StatementAlloc packNextOperatorPart(Ptr& it, const Operator& oper);
+    class ListSource
+    {
+    private:
+        Ptr _it;
+
+    public:
+        ListSource(const CodeFragmentSpan& span) : _it{ span.ptr() } {}
+
+        bool end() const { return !_it; }
+        size_t position() const { return _it.index(); }
+        void next() { _it++; }
+
+        std::string text() const { return _it->toString(); }
+        ParserError error(const std::string& msg) const { return { _it.line(), msg.c_str() }; }
+
+        bool isOperator() const { return _it->is(CodeFragmentType::Operator); }
+
+        const Operator* prefix() const
+        {
+            const Operator& op = _it->as<Operator>();
+            return op.isUnary() ? &op : nullptr;
+        }
+
+        const Operator* sufix() const
+        {
+            if (!isOperator() || !_it->as<Operator>().isUnary())
+                return nullptr;
+
+            const Operator& op = _it->as<Operator>();
+            if (op.hasRightToLeft())
+                throw error("Operator " + op.toString() + " cannot be an unary sufix operator");
+            return &op;
+        }
+
+        const Operator* infix() const { return isOperator() ? &_it->as<Operator>() : nullptr; }
+
+        bool isOpenGroup() const { return false; }
+        bool isCloseGroup() const { return false; }
+        bool isTernarySeparator() const { return *_it == Stopchar::TwoPoints; }
+
+        StatementAlloc operand()
+        {
+            const CodeFragment& part = *_it;
+            if (!part.isStatement())
+                throw error("Expected valid operand. But found: " + part.toString());
+            _it++;
+            return part.as<Statement>();
+        }
+
+        NodeId located(size_t, NodeId = INVALID_NODE, NodeId = INVALID_NODE, NodeId = INVALID_NODE) const { return INVALID_NODE; }
+    };
 }
 
 
 namespace parser::statement
 {
-	CloneableAllocator<Statement> parse(const CodeFragmentList& list)
+	CloneableAllocator<Statement> parse(const CodeFragmentList& list, size_t maxNesting) { return parse(list.span(), maxNesting); }
+
+	CloneableAllocator<Statement> parse(const CodeFragmentSpan& span, size_t maxNesting)
 	{
-		impl::Ptr it = list.ptr();
-        impl::StatementAlloc operand = impl::packPart(it);
-		if (!it)
-			return operand;
-		return impl::packOperation(it, operand);
+		impl::ListSource src{ span };
+		return climb::Climber<impl::ListSource>{ src, maxNesting }.parse();
 	}
 }
 
@@ -33,161 +342,202 @@ namespace parser::statement
 
 
 
-namespace parser::statement::impl
+
+
+
+
+
+namespace parser::statement::token_impl
 {
-	static ParserError error(const size_t line, const std::string& msg = "") { return { line, msg.c_str() }; }
-	static ParserError error(const Ptr& it, const std::string& msg = "") { return { it.line(), msg.c_str() }; }
-	static ParserError error(const CodeFragmentList& list, const std::string& msg = "") { return { list.sourceLine(), msg.c_str() }; }
+    typedef CloneableAllocator<Statement> StatementAlloc;
+    typedef lexer::TokenKind TokenKind;
+    typedef lexer::OperatorCode OperatorCode;
 
-	StatementAlloc packPart(Ptr& it)
-	{
-		if (!it)
-			throw error(it, "Unexpected end of instruction");
-		return packPostUnary(it, packPreUnary(it));
-	}
+    struct Cursor
+    {
+        const lexer::TokenStream& tokens;
+        size_t begin;
+        size_t index;
+        size_t end;
 
-	StatementAlloc packPreUnary(Ptr& it)
-	{
-		CodeFragmentAlloc part = *it;
-        it++;
-        if (part->is(CodeFragmentType::Operator))
-        {
-            if (!it)
-                throw error(it, "unexpected end of instruction");
+        inline operator bool() const { return index < end; }
+        inline bool operator! () const { return index >= end; }
+    };
 
-            const Operator& prefix = part->as<Operator>();
-            if (!prefix.isUnary())
-                throw error(it, "Operator " + prefix.toString() + " cannot be a non unary prefix operator");
+    static size_t lineOf(const lexer::TokenStream& tokens, size_t index)
+    {
+        if (!tokens.source() || index >= tokens.size())
+            return 0;
+        const char* const source = tokens.source();
+        return tokens.firstLine() + static_cast<size_t>(std::count(source, source + tokens.offset(index), '\n'));
+    }
 
-            part = packNextOperatorPart(it, part->as<Operator>());
-            if (!part->isStatement())
-                throw error(it, "Expected valid operand. But found: " + part->toString());
+    static ParserError error(const Cursor& it, const std::string& msg = "")
+    {
+        return { lineOf(it.tokens, it.index < it.end ? it.index : it.end - 1), msg.c_str() };
+    }
 
-            return Operation::unary(prefix, part->as<Statement>());
-        }
-        if (!part->isStatement())
-            throw error(it, "Expected valid operand. But found: " + part->toString());
-        return part->as<Statement>();
-	}
+    static std::string text(const Cursor& it) { return std::string{ it.tokens.text(it.index) }; }
 
-	StatementAlloc packPostUnary(Ptr& it, const Statement& pre)
-	{
-        if (!it)
-            return pre;
-        CodeFragmentAlloc part = *it;
+    /* Records the tokens [first, it.index) as an occurrence with the given operands, if spans are being recorded */
+    static NodeId located(const Cursor& it, size_t first, NodeId operand0, NodeId operand1, NodeId operand2)
+    {
+        SourceMap* map = SourceMap::current();
+        if (!map || first >= it.index)
+            return INVALID_NODE;
+        return map->add(SourceSpan::join(it.tokens.span(first), it.tokens.span(it.index - 1)), operand0, operand1, operand2);
+    }
 
-        if (part->is(CodeFragmentType::Operator))
+    static bool endsOperand(const lexer::TokenStream& tokens, size_t begin, size_t index)
+    {
+        for (;;)
         {
-            const Operator& sufix = part->as<Operator>();
-            if (!sufix.isUnary())
-                return pre;
+            switch (tokens.kind(index))
+            {
+                case TokenKind::Identifier:
+                case TokenKind::Integer:
+                    return true;
 
-            it++;
-            if (sufix.hasRightToLeft())
-                throw error(it, "Operator " + sufix.toString() + " cannot be an unary sufix operator");
+                case TokenKind::Bracket:
+                    return tokens.isChar(index, ')');
 
-            return packPostUnary(it, Operation::unary(sufix, pre));
+                case TokenKind::Operator:
+                    if (index == begin || !(tokens.isOperator(index, OperatorCode::Increment) || tokens.isOperator(index, OperatorCode::Decrement)))
+                        return false;
+                    --index;
+                    break;
+
+                default:
+                    return false;
+            }
         }
-        return pre;
-	}
+    }
 
-    const Operator* findNextOperatorSymbol(const CodeFragmentList& list, size_t index)
+    static const Operator* prefixOperator(OperatorCode code)
     {
-        size_t len = list.size();
-        for (size_t i = index; i < len; i++)
-            if (list[i].is(CodeFragmentType::Operator))
-                return &list[i].as<Operator>();
-        return nullptr;
+        switch (code)
+        {
+            case OperatorCode::Increment: return &Operator::PrefixIncrement;
+            case OperatorCode::Decrement: return &Operator::PrefixDecrement;
+            case OperatorCode::Minus: return &Operator::UnaryMinus;
+            case OperatorCode::Not: return &Operator::BinaryNot;
+            default: return nullptr;
+        }
     }
 
-    StatementAlloc getSuperOperatorScope(Ptr& it, const Operator& base)
+    static const Operator* infixOperator(OperatorCode code)
     {
-        size_t start = it.index();
-        for (; it; it++)
+        switch (code)
         {
-            if (!it->is(CodeFragmentType::Operator))
-                continue;
-
-            const Operator& op = it->as<Operator>();
-            if (base.comparePriority(op) > 0)
-            {
-                //it.decrease();
-                return parse(it.list().sublist(start, it.index() - start));
-            }
+            case OperatorCode::Increment: return &Operator::SufixIncrement;
+            case OperatorCode::Decrement: return &Operator::SufixDecrement;
+            case OperatorCode::Plus: return &Operator::Addition;
+            case OperatorCode::Minus: return &Operator::Subtraction;
+            case OperatorCode::Star: return &Operator::Multiplication;
+            case OperatorCode::Slash: return &Operator::Division;
+            case OperatorCode::Greater: return &Operator::GreaterThan;
+            case OperatorCode::Smaller: return &Operator::SmallerThan;
+            case OperatorCode::GreaterEquals: return &Operator::GreaterEqualsThan;
+            case OperatorCode::SmallerEquals: return &Operator::SmallerEqualsThan;
+            case OperatorCode::Equals: return &Operator::EqualsTo;
+            case OperatorCode::NotEquals: return &Operator::NotEqualsTo;
+            case OperatorCode::And: return &Operator::BinaryAnd;
+            case OperatorCode::Or: return &Operator::BinaryOr;
+            case OperatorCode::Question: return &Operator::TernaryConditional;
+            case OperatorCode::Assign: return &Operator::Assignment;
+            case OperatorCode::PlusAssign: return &Operator::AssignmentAddition;
+            case OperatorCode::MinusAssign: return &Operator::AssignmentSubtraction;
+            case OperatorCode::StarAssign: return &Operator::AssignmentMultiplication;
+            case OperatorCode::SlashAssign: return &Operator::AssignmentDivision;
+            default: return nullptr;
         }
-        return parse(it.list().sublist(start));
     }
 
-    StatementAlloc packOperation(Ptr& it, const Statement& operand1)
+    /* Operator meant by the token at index, which depends on whether an operand precedes it */
+    static const Operator* operatorAt(const Cursor& it, size_t index)
     {
-        if (!it->is(CodeFragmentType::Operator))
-            throw error(it, "Expected a valid operator between operands. \"" + it->toString() + "\"");
-        const Operator& oper = it->as<Operator>();
-        it++;
-        StatementAlloc operation;
+        if (it.tokens.kind(index) != TokenKind::Operator)
+            return nullptr;
+
+        const OperatorCode code = static_cast<OperatorCode>(it.tokens.payload(index));
+        if (index > it.begin && endsOperand(it.tokens, it.begin, index - 1))
+            return infixOperator(code);
+        return prefixOperator(code);
+    }
 
-        if (oper.isTernary())
+    static StatementAlloc operand(Cursor& it)
+    {
+        const size_t index = it.index;
+        switch (it.tokens.kind(index))
         {
-            size_t start = it.index();
-            size_t terOp = 0;
-            for (; it; it++)
-            {
-                const CodeFragment& c = *it;
-                if (c == Operator::TernaryConditional)
-                    terOp++;
-                else if (c == Stopchar::TwoPoints)
-                {
-                    if (terOp == 0)
-                        break;
-                    terOp--;
-                }
+            case TokenKind::Identifier: {
+                const std::string name{ it.tokens.text(index) };
+                ++it.index;
+
+                CodeValue code;
+                if (DataType::findTypeFromValueName(name, code))
+                    return TypeConstant::parse(code);
+                if (!it.tokens.symbols())
+                    return Identifier{ name };
+                return Identifier{ it.tokens.payload(index), *it.tokens.symbols() };
             }
-            if (!it)
-                throw error(it, "Expected a : in ternary operator");
 
-            const Statement& response1 = parse(it.list().sublist(start, it.index() - start));
-            it++;
-            const Statement& response2 = parse(it.list().sublist(it.index()));
-            it.finish();
-            return Operation::ternary(operand1, response1, response2);
-        }
-        else if (oper.isBinary())
-        {
-            const Statement& operand2 = packNextOperatorPart(it, oper);
-            operation = Operation::binary(oper, operand1, operand2);
+            case TokenKind::Integer:
+                ++it.index;
+                return LiteralInteger{ static_cast<FieldValue>(it.tokens.payload(index)) };
+
+            default:
+                break;
         }
-        else if (oper.isAssignment())
+        throw error(it, "Expected valid operand. But found: " + text(it));
+    }
+
+    class TokenSource
+    {
+    private:
+        Cursor _it;
+
+    public:
+        TokenSource(const lexer::TokenStream& tokens, size_t begin, size_t end) : _it{ tokens, begin, begin, end } {}
+
+        bool end() const { return !_it; }
+        size_t position() const { return _it.index; }
+        void next() { _it.index++; }
+
+        std::string text() const { return token_impl::text(_it); }
+        ParserError error(const std::string& msg) const { return token_impl::error(_it, msg); }
+
+        bool isOperator() const { return _it.tokens.kind(_it.index) == TokenKind::Operator; }
+
+        const Operator* prefix() const { return operatorAt(_it, _it.index); }
+
+        const Operator* sufix() const
         {
-            const Statement& operand2 = packNextOperatorPart(it, oper);
-            operation = Operation::assignment(oper, operand1, operand2);
+            const Operator* op = operatorAt(_it, _it.index);
+            return op && op->isUnary() ? op : nullptr;
         }
-        /*else if (operator.isCall())
-        {
-            if (it.end())
-                throw new CompilerError("Expected a valid arguments list in call operator.");
-            CodeFragment args = it.listValue();
-            it.increase();
-            operation = Operation.call(operand1, args);
-        }*/
-        else throw error(it, "Invalid operator type: " + oper.toString());
 
+        const Operator* infix() const { return operatorAt(_it, _it.index); }
 
-        if (!it)
-            return operation;
-        return packOperation(it, operation);
-    }
+        bool isOpenGroup() const { return _it.tokens.isChar(_it.index, '('); }
+        bool isCloseGroup() const { return _it.tokens.isChar(_it.index, ')'); }
+        bool isTernarySeparator() const { return _it.tokens.isChar(_it.index, ':'); }
 
-    StatementAlloc packNextOperatorPart(Ptr& it, const Operator& oper)
-    {
-        const Operator* nextOperator = findNextOperatorSymbol(it.list(), it.index());
-        if (nextOperator && oper.comparePriority(*nextOperator) >= 0)
-            nextOperator = nullptr;
+        StatementAlloc operand() { return token_impl::operand(_it); }
+
+        NodeId located(size_t first, NodeId operand0 = INVALID_NODE, NodeId operand1 = INVALID_NODE, NodeId operand2 = INVALID_NODE) const
+        {
+            return token_impl::located(_it, first, operand0, operand1, operand2);
+        }
+    };
+}
 
-        StatementAlloc operand2;
-        if (nextOperator)
-            operand2 = getSuperOperatorScope(it, oper);
-        else operand2 = packPart(it);
 
-        return operand2;
+namespace parser::statement
+{
+    CloneableAllocator<Statement> parse(const lexer::TokenStream& tokens, size_t begin, size_t end, size_t maxNesting)
+    {
+        token_impl::TokenSource src{ tokens, begin, end };
+        return climb::Climber<token_impl::TokenSource>{ src, maxNesting }.parse();
     }
 }
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/* Compile-time perfect hashing for small sets of names known at build time */
+namespace perfect_hash
+{
+	constexpr uint32_t hash(const char* str, size_t len, uint32_t seed)
+	{
+		uint32_t h = 2166136261U ^ (seed * 0x9E3779B9U);
+		for (size_t i = 0; i < len; ++i)
+		{
+			h ^= static_cast<uint8_t>(str[i]);
+			h *= 16777619U;
+		}
+		return h ^ (h >> 15);
+	}
+
+	constexpr size_t length(const char* str)
+	{
+		size_t len = 0;
+		while (str[len])
+			++len;
+		return len;
+	}
+
+	template<typename _Ty>
+	struct Entry
+	{
+		const char* name;
+		_Ty value;
+	};
+
+	template<typename _Ty, size_t _Count, size_t _Slots>
+	class Table
+	{
+		static_assert(_Slots > 0 && (_Slots & (_Slots - 1)) == 0, "Slots must be a power of two");
+		static_assert(_Count < 0xFFFF, "Too many entries");
+
+	private:
+		static constexpr uint32_t MAX_SEEDS = 0x10000;
+
+		uint32_t _seed;
+		bool _valid;
+		uint16_t _slots[_Slots];
+		Entry<_Ty> _entries[_Count];
+		size_t _lengths[_Count];
+
+	public:
+		/* Entries with an empty name are kept out of the table */
+		constexpr Table(const Entry<_Ty>(&entries)[_Count]) :
+			_seed{ 0 },
+			_valid{ false },
+			_slots{},
+			_entries{},
+			_lengths{}
+		{
+			for (size_t i = 0; i < _Count; ++i)
+			{
+				_entries[i] = entries[i];
+				_lengths[i] = length(entries[i].name);
+			}
+
+			for (uint32_t seed = 0; seed < MAX_SEEDS && !_valid; ++seed)
+			{
+				uint64_t used[(_Slots + 63) / 64] = {};
+
+				_valid = true;
+				for (size_t i = 0; i < _Count && _valid; ++i)
+				{
+					if (_lengths[i] == 0)
+						continue;
+
+					const size_t slot = hash(_entries[i].name, _lengths[i], seed) & (_Slots - 1);
+					const uint64_t bit = uint64_t{ 1 } << (slot % 64);
+					if (used[slot / 64] & bit)
+						_valid = false;
+					else used[slot / 64] |= bit;
+				}
+				_seed = seed;
+			}
+
+			if (_valid)
+			{
+				for (size_t i = 0; i < _Count; ++i)
+					if (_lengths[i] != 0)
+						_slots[hash(_entries[i].name, _lengths[i], _seed) & (_Slots - 1)] = static_cast<uint16_t>(i + 1);
+			}
+		}
+
+		constexpr bool isValid() const { return _valid; }
+
+		const _Ty* find(const char* name, size_t len) const
+		{
+			const uint16_t slot = _slots[hash(name, len, _seed) & (_Slots - 1)];
+			if (slot == 0)
+				return nullptr;
+
+			const size_t index = slot - 1U;
+			if (_lengths[index] != len || std::memcmp(_entries[index].name, name, len) != 0)
+				return nullptr;
+			return &_entries[index].value;
+		}
+
+		inline const _Ty* find(const std::string& name) const { return find(name.data(), name.size()); }
+
+		constexpr size_t size() const { return _Count; }
+		constexpr const Entry<_Ty>& operator[] (size_t index) const { return _entries[index]; }
+	};
+}
@@ -0,0 +1,348 @@
+#include "scanutils.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#endif
+
+#ifdef SCAN_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SCAN_TARGET_SSE2
+#define SCAN_TARGET_AVX2
+#else
+#define SCAN_TARGET_SSE2 __attribute__((target("sse2")))
+#define SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+namespace scan::scalar
+{
+	static inline bool isBlank(unsigned char c) { return c == ' ' || c == '\t'; }
+	static inline bool isWhitespace(unsigned char c) { return c == ' ' || static_cast<unsigned char>(c - '\t') <= 4; }
+	static inline bool isIdentifierChar(unsigned char c)
+	{
+		return static_cast<unsigned char>((c | 0x20) - 'a') < 26 || static_cast<unsigned char>(c - '0') < 10 || c == '_';
+	}
+
+	const char* findNewline(const char* begin, const char* end)
+	{
+		if (begin >= end)
+			return end;
+		const void* found = std::memchr(begin, '\n', end - begin);
+		return found ? reinterpret_cast<const char*>(found) : end;
+	}
+
+	const char* findBlockCommentEnd(const char* begin, const char* end)
+	{
+		for (const char* ptr = begin; ptr + 1 < end; ++ptr)
+			if (ptr[0] == '*' && ptr[1] == '/')
+				return ptr;
+		return end;
+	}
+
+	const char* skipBlanks(const char* begin, const char* end)
+	{
+		while (begin < end && isBlank(*begin))
+			++begin;
+		return begin;
+	}
+
+	const char* skipWhitespace(const char* begin, const char* end)
+	{
+		while (begin < end && isWhitespace(*begin))
+			++begin;
+		return begin;
+	}
+
+	const char* skipIdentifier(const char* begin, const char* end)
+	{
+		while (begin < end && isIdentifierChar(*begin))
+			++begin;
+		return begin;
+	}
+}
+
+
+
+
+#ifdef SCAN_X86
+namespace
+{
+	inline unsigned int first_bit(uint32_t mask)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long idx;
+		_BitScanForward(&idx, mask);
+		return static_cast<unsigned int>(idx);
+#else
+		return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+	}
+
+	/* x in [lo, lo + span] as unsigned bytes */
+	SCAN_TARGET_SSE2 inline __m128i sse2_in_range(__m128i x, char lo, char span)
+	{
+		const __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+		const __m128i limit = _mm_set1_epi8(span);
+		return _mm_cmpeq_epi8(_mm_max_epu8(shifted, limit), limit);
+	}
+
+	SCAN_TARGET_AVX2 inline __m256i avx2_in_range(__m256i x, char lo, char span)
+	{
+		const __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+		const __m256i limit = _mm256_set1_epi8(span);
+		return _mm256_cmpeq_epi8(_mm256_max_epu8(shifted, limit), limit);
+	}
+
+
+	/* SSE2 kernels */
+
+	SCAN_TARGET_SSE2 const char* sse2_findNewline(const char* begin, const char* end)
+	{
+		const __m128i nl = _mm_set1_epi8('\n');
+		for (; begin + 16 <= end; begin += 16)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, nl)));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return scan::scalar::findNewline(begin, end);
+	}
+
+	SCAN_TARGET_SSE2 const char* sse2_findBlockCommentEnd(const char* begin, const char* end)
+	{
+		const __m128i star = _mm_set1_epi8('*');
+		const __m128i slash = _mm_set1_epi8('/');
+		for (; begin + 17 <= end; begin += 16)
+		{
+			const __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			const __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + 1));
+			const __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(x0, star), _mm_cmpeq_epi8(x1, slash));
+			const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return scan::scalar::findBlockCommentEnd(begin, end);
+	}
+
+	SCAN_TARGET_SSE2 const char* sse2_skipBlanks(const char* begin, const char* end)
+	{
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i tab = _mm_set1_epi8('\t');
+		for (; begin + 16 <= end; begin += 16)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			const __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmpeq_epi8(x, tab));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(blank)) & 0xffffU;
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return scan::scalar::skipBlanks(begin, end);
+	}
+
+	SCAN_TARGET_SSE2 const char* sse2_skipWhitespace(const char* begin, const char* end)
+	{
+		const __m128i space = _mm_set1_epi8(' ');
+		for (; begin + 16 <= end; begin += 16)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			const __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(x, space), sse2_in_range(x, '\t', 4));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(ws)) & 0xffffU;
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return scan::scalar::skipWhitespace(begin, end);
+	}
+
+	SCAN_TARGET_SSE2 const char* sse2_skipIdentifier(const char* begin, const char* end)
+	{
+		const __m128i lower = _mm_set1_epi8(0x20);
+		const __m128i underscore = _mm_set1_epi8('_');
+		for (; begin + 16 <= end; begin += 16)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			const __m128i alpha = sse2_in_range(_mm_or_si128(x, lower), 'a', 25);
+			const __m128i digit = sse2_in_range(x, '0', 9);
+			const __m128i id = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(x, underscore));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(id)) & 0xffffU;
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return scan::scalar::skipIdentifier(begin, end);
+	}
+
+
+	/* AVX2 kernels */
+
+	SCAN_TARGET_AVX2 const char* avx2_findNewline(const char* begin, const char* end)
+	{
+		const __m256i nl = _mm256_set1_epi8('\n');
+		for (; begin + 32 <= end; begin += 32)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+			const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, nl)));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return sse2_findNewline(begin, end);
+	}
+
+	SCAN_TARGET_AVX2 const char* avx2_findBlockCommentEnd(const char* begin, const char* end)
+	{
+		const __m256i star = _mm256_set1_epi8('*');
+		const __m256i slash = _mm256_set1_epi8('/');
+		for (; begin + 33 <= end; begin += 32)
+		{
+			const __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+			const __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin + 1));
+			const __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(x0, star), _mm256_cmpeq_epi8(x1, slash));
+			const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return sse2_findBlockCommentEnd(begin, end);
+	}
+
+	SCAN_TARGET_AVX2 const char* avx2_skipBlanks(const char* begin, const char* end)
+	{
+		const __m256i space = _mm256_set1_epi8(' ');
+		const __m256i tab = _mm256_set1_epi8('\t');
+		for (; begin + 32 <= end; begin += 32)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+			const __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(x, space), _mm256_cmpeq_epi8(x, tab));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(blank));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return sse2_skipBlanks(begin, end);
+	}
+
+	SCAN_TARGET_AVX2 const char* avx2_skipWhitespace(const char* begin, const char* end)
+	{
+		const __m256i space = _mm256_set1_epi8(' ');
+		for (; begin + 32 <= end; begin += 32)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+			const __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(x, space), avx2_in_range(x, '\t', 4));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return sse2_skipWhitespace(begin, end);
+	}
+
+	SCAN_TARGET_AVX2 const char* avx2_skipIdentifier(const char* begin, const char* end)
+	{
+		const __m256i lower = _mm256_set1_epi8(0x20);
+		const __m256i underscore = _mm256_set1_epi8('_');
+		for (; begin + 32 <= end; begin += 32)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+			const __m256i alpha = avx2_in_range(_mm256_or_si256(x, lower), 'a', 25);
+			const __m256i digit = avx2_in_range(x, '0', 9);
+			const __m256i id = _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(x, underscore));
+			const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(id));
+			if (mask)
+				return begin + first_bit(mask);
+		}
+		return sse2_skipIdentifier(begin, end);
+	}
+
+
+	scan::InstructionSet detect_instruction_set()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		const bool sse2 = (info[3] & (1 << 26)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+
+		bool avx2 = false;
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		const bool sse2 = __builtin_cpu_supports("sse2");
+		const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		return avx2 ? scan::InstructionSet::AVX2 : sse2 ? scan::InstructionSet::SSE2 : scan::InstructionSet::Scalar;
+	}
+}
+#endif
+
+
+
+
+namespace
+{
+	typedef const char* (*Kernel)(const char*, const char*);
+
+	struct KernelTable
+	{
+		scan::InstructionSet set;
+		Kernel findNewline;
+		Kernel findBlockCommentEnd;
+		Kernel skipBlanks;
+		Kernel skipWhitespace;
+		Kernel skipIdentifier;
+	};
+
+	KernelTable select_kernels()
+	{
+#ifdef SCAN_X86
+		switch (detect_instruction_set())
+		{
+			case scan::InstructionSet::AVX2:
+				return { scan::InstructionSet::AVX2, avx2_findNewline, avx2_findBlockCommentEnd, avx2_skipBlanks, avx2_skipWhitespace, avx2_skipIdentifier };
+			case scan::InstructionSet::SSE2:
+				return { scan::InstructionSet::SSE2, sse2_findNewline, sse2_findBlockCommentEnd, sse2_skipBlanks, sse2_skipWhitespace, sse2_skipIdentifier };
+			default:
+				break;
+		}
+#endif
+		return {
+			scan::InstructionSet::Scalar,
+			scan::scalar::findNewline,
+			scan::scalar::findBlockCommentEnd,
+			scan::scalar::skipBlanks,
+			scan::scalar::skipWhitespace,
+			scan::scalar::skipIdentifier
+		};
+	}
+
+	const KernelTable& kernels()
+	{
+		static const KernelTable table = select_kernels();
+		return table;
+	}
+}
+
+
+
+namespace scan
+{
+	InstructionSet activeInstructionSet() { return kernels().set; }
+
+	const char* findNewline(const char* begin, const char* end) { return kernels().findNewline(begin, end); }
+	const char* findBlockCommentEnd(const char* begin, const char* end) { return kernels().findBlockCommentEnd(begin, end); }
+	const char* skipBlanks(const char* begin, const char* end) { return kernels().skipBlanks(begin, end); }
+	const char* skipWhitespace(const char* begin, const char* end) { return kernels().skipWhitespace(begin, end); }
+	const char* skipIdentifier(const char* begin, const char* end) { return kernels().skipIdentifier(begin, end); }
+}
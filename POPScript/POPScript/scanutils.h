@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+namespace scan
+{
+	enum class InstructionSet
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	InstructionSet activeInstructionSet();
+
+
+	/* All kernels scan [begin, end) and return end when nothing is found */
+
+	const char* findNewline(const char* begin, const char* end);
+
+	/* Returns a pointer to the '*' of the first "*\/" */
+	const char* findBlockCommentEnd(const char* begin, const char* end);
+
+	/* Space and tab */
+	const char* skipBlanks(const char* begin, const char* end);
+
+	/* Space, tab, newline, carriage return, vertical tab and form feed */
+	const char* skipWhitespace(const char* begin, const char* end);
+
+	/* [_a-zA-Z0-9] */
+	const char* skipIdentifier(const char* begin, const char* end);
+
+
+	namespace scalar
+	{
+		const char* findNewline(const char* begin, const char* end);
+		const char* findBlockCommentEnd(const char* begin, const char* end);
+		const char* skipBlanks(const char* begin, const char* end);
+		const char* skipWhitespace(const char* begin, const char* end);
+		const char* skipIdentifier(const char* begin, const char* end);
+	}
+}
@@ -0,0 +1,67 @@
+#include "spans.h"
+
+#include <algorithm>
+
+#include "utils.h"
+
+SourceSpan SourceSpan::join(const SourceSpan& s0, const SourceSpan& s1)
+{
+	const uint32_t offset = std::min(s0.offset, s1.offset);
+	return { offset, std::max(s0.end(), s1.end()) - offset };
+}
+
+
+
+
+static thread_local SourceMap* current_map = nullptr;
+
+SourceMap::Scope::Scope(SourceMap& map) :
+	_previous{ current_map }
+{
+	current_map = &map;
+}
+SourceMap::Scope::~Scope() { current_map = _previous; }
+
+
+
+
+SourceMap::SourceMap() :
+	_entries{}
+{}
+SourceMap::~SourceMap() {}
+
+NodeId SourceMap::add(const SourceSpan& span, NodeId operand0, NodeId operand1, NodeId operand2)
+{
+	_entries.push_back({ span, { operand0, operand1, operand2 } });
+	return static_cast<NodeId>(_entries.size());
+}
+
+void SourceMap::set(NodeId node, const SourceSpan& span)
+{
+	if (!has(node))
+		throw BadIndex{ static_cast<int>(node), 1, static_cast<int>(_entries.size()) };
+	_entries[node - 1].span = span;
+}
+
+bool SourceMap::has(NodeId node) const { return node != INVALID_NODE && node <= _entries.size(); }
+
+SourceSpan SourceMap::get(NodeId node) const
+{
+	if (!has(node))
+		throw BadIndex{ static_cast<int>(node), 1, static_cast<int>(_entries.size()) };
+	return _entries[node - 1].span;
+}
+
+NodeId SourceMap::operand(NodeId node, size_t index) const
+{
+	if (!has(node))
+		throw BadIndex{ static_cast<int>(node), 1, static_cast<int>(_entries.size()) };
+	return index < MAX_OPERANDS ? _entries[node - 1].operands[index] : INVALID_NODE;
+}
+
+NodeId SourceMap::last() const { return static_cast<NodeId>(_entries.size()); }
+
+size_t SourceMap::size() const { return _entries.size(); }
+void SourceMap::clear() { _entries.clear(); }
+
+SourceMap* SourceMap::current() { return current_map; }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+typedef uint32_t NodeId;
+
+constexpr NodeId INVALID_NODE = 0;
+
+struct SourceSpan
+{
+	uint32_t offset;
+	uint32_t length;
+
+	inline uint32_t end() const { return offset + length; }
+
+	inline bool operator== (const SourceSpan& s) const { return offset == s.offset && length == s.length; }
+	inline bool operator!= (const SourceSpan& s) const { return !operator==(s); }
+
+	/* Smallest span covering both */
+	static SourceSpan join(const SourceSpan& s0, const SourceSpan& s1);
+};
+
+/*
+ * Side table of source spans indexed by NodeId. Spans belong to occurrences, not to nodes: equal statements may
+ * share one node, so each occurrence also keeps the NodeIds of its operands' occurrences, mirroring the tree.
+ * An occurrence is added after its operands, so the last NodeId is the root of the statement parsed last.
+ */
+class SourceMap
+{
+public:
+	static constexpr size_t MAX_OPERANDS = 3;
+
+	/* Makes a map the current one of the calling thread while alive */
+	class Scope
+	{
+	private:
+		SourceMap* _previous;
+
+	public:
+		Scope(SourceMap& map);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+	};
+
+private:
+	struct Entry
+	{
+		SourceSpan span;
+		NodeId operands[MAX_OPERANDS];
+	};
+
+	std::vector<Entry> _entries;
+
+public:
+	SourceMap();
+	SourceMap(const SourceMap&) = default;
+	SourceMap(SourceMap&&) noexcept = default;
+	~SourceMap();
+
+	SourceMap& operator= (const SourceMap&) = default;
+	SourceMap& operator= (SourceMap&&) noexcept = default;
+
+	NodeId add(const SourceSpan& span, NodeId operand0 = INVALID_NODE, NodeId operand1 = INVALID_NODE, NodeId operand2 = INVALID_NODE);
+	void set(NodeId node, const SourceSpan& span);
+
+	bool has(NodeId node) const;
+	SourceSpan get(NodeId node) const;
+
+	/* Occurrence of the operand at index of node, INVALID_NODE if it has none */
+	NodeId operand(NodeId node, size_t index) const;
+
+	/* Last occurrence added, INVALID_NODE if none */
+	NodeId last() const;
+
+	size_t size() const;
+	void clear();
+
+	inline SourceSpan operator[] (NodeId node) const { return get(node); }
+
+public:
+	/* Map of the running compilation, or nullptr if spans are not being recorded */
+	static SourceMap* current();
+};
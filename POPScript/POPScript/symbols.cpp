@@ -0,0 +1,126 @@
+#include "symbols.h"
+
+#include <cstring>
+
+#include "utils.h"
+
+static thread_local SymbolTable* current_table = nullptr;
+
+SymbolTable::Scope::Scope(SymbolTable& table) :
+	_previous{ current_table }
+{
+	current_table = &table;
+}
+SymbolTable::Scope::~Scope() { current_table = _previous; }
+
+
+
+
+SymbolTable::SymbolTable() :
+	_blocks{},
+	_blockUsed{ BLOCK_SIZE },
+	_names{},
+	_hashes{},
+	_slots(64, INVALID_SYMBOL)
+{}
+SymbolTable::~SymbolTable() {}
+
+Symbol SymbolTable::intern(std::string_view name)
+{
+	const uint32_t h = hash(name);
+	const size_t slot = slotOf(name, h);
+	if (_slots[slot] != INVALID_SYMBOL)
+		return _slots[slot];
+
+	_names.emplace_back(store(name), name.size());
+	_hashes.push_back(h);
+
+	const Symbol symbol = static_cast<Symbol>(_names.size());
+	_slots[slot] = symbol;
+
+	if (_names.size() * 2 > _slots.size())
+		rehash(_slots.size() * 2);
+
+	return symbol;
+}
+
+Symbol SymbolTable::find(std::string_view name) const { return _slots[slotOf(name, hash(name))]; }
+
+std::string_view SymbolTable::name(Symbol symbol) const
+{
+	if (symbol == INVALID_SYMBOL || symbol > _names.size())
+		throw BadIndex{ static_cast<int>(symbol), 1, static_cast<int>(_names.size()) };
+	return _names[symbol - 1];
+}
+
+size_t SymbolTable::size() const { return _names.size(); }
+
+const char* SymbolTable::store(std::string_view name)
+{
+	if (name.empty())
+		return "";
+
+	if (name.size() > BLOCK_SIZE / 4)
+	{
+		/* Long names get their own block, kept before the one being filled */
+		std::unique_ptr<char[]> block{ new char[name.size()] };
+		char* dst = block.get();
+		std::memcpy(dst, name.data(), name.size());
+		_blocks.insert(_blocks.empty() ? _blocks.end() : _blocks.end() - 1, std::move(block));
+		return dst;
+	}
+
+	if (_blockUsed + name.size() > BLOCK_SIZE)
+	{
+		_blocks.emplace_back(new char[BLOCK_SIZE]);
+		_blockUsed = 0;
+	}
+
+	char* dst = _blocks.back().get() + _blockUsed;
+	std::memcpy(dst, name.data(), name.size());
+	_blockUsed += name.size();
+	return dst;
+}
+
+void SymbolTable::rehash(size_t slots)
+{
+	_slots.assign(slots, INVALID_SYMBOL);
+	for (size_t i = 0; i < _names.size(); ++i)
+	{
+		size_t slot = _hashes[i] & (slots - 1);
+		while (_slots[slot] != INVALID_SYMBOL)
+			slot = (slot + 1) & (slots - 1);
+		_slots[slot] = static_cast<Symbol>(i + 1);
+	}
+}
+
+size_t SymbolTable::slotOf(std::string_view name, uint32_t hash) const
+{
+	const size_t mask = _slots.size() - 1;
+	size_t slot = hash & mask;
+	for (;;)
+	{
+		const Symbol symbol = _slots[slot];
+		if (symbol == INVALID_SYMBOL || (_hashes[symbol - 1] == hash && _names[symbol - 1] == name))
+			return slot;
+		slot = (slot + 1) & mask;
+	}
+}
+
+SymbolTable& SymbolTable::current()
+{
+	if (!current_table)
+		throw IllegalState{ "No SymbolTable is current; open a SymbolTable::Scope or a Compilation" };
+	return *current_table;
+}
+
+uint32_t SymbolTable::hash(std::string_view name)
+{
+	uint32_t h = 2166136261U;
+	for (const char c : name)
+	{
+		h ^= static_cast<uint8_t>(c);
+		h *= 16777619U;
+	}
+	return h;
+}
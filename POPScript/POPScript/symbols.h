@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+typedef uint32_t Symbol;
+
+constexpr Symbol INVALID_SYMBOL = 0;
+
+/* String interner. Every distinct name is stored once in a block arena and identified by a 32-bit Symbol. */
+class SymbolTable
+{
+public:
+	/* Makes a table the current one of the calling thread while alive */
+	class Scope
+	{
+	private:
+		SymbolTable* _previous;
+
+	public:
+		Scope(SymbolTable& table);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+	};
+
+private:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	std::vector<std::unique_ptr<char[]>> _blocks;
+	size_t _blockUsed;
+
+	std::vector<std::string_view> _names;
+	std::vector<uint32_t> _hashes;
+	std::vector<Symbol> _slots;
+
+public:
+	SymbolTable();
+	~SymbolTable();
+
+	SymbolTable(const SymbolTable&) = delete;
+	SymbolTable(SymbolTable&&) = delete;
+
+	SymbolTable& operator= (const SymbolTable&) = delete;
+	SymbolTable& operator= (SymbolTable&&) = delete;
+
+	Symbol intern(std::string_view name);
+	Symbol find(std::string_view name) const;
+
+	/* Views stay valid for the lifetime of the table */
+	std::string_view name(Symbol symbol) const;
+
+	size_t size() const;
+
+	inline std::string_view operator[] (Symbol symbol) const { return name(symbol); }
+
+private:
+	const char* store(std::string_view name);
+	void rehash(size_t slots);
+
+	size_t slotOf(std::string_view name, uint32_t hash) const;
+
+public:
+	/* Table of the running compilation. Throws IllegalState if the calling thread has no Scope open. */
+	static SymbolTable& current();
+
+	static uint32_t hash(std::string_view name);
+};
+
+struct SymbolHash
+{
+	inline size_t operator() (Symbol symbol) const { return static_cast<size_t>(symbol) * 0x9E3779B9U; }
+};
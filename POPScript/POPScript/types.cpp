@@ -2,12 +2,13 @@
 
 #include <algorithm>
 
+#include "perfect_hash.h"
+
 _NativeDataType::_NativeDataType(const uint8_t id, const std::string& name) :
 	_id{ id },
 	_name{ name },
 	_integerType{ true },
 	_avByName{},
-	_avByValue{},
 	_defvalue{ 0 }
 {}
 
@@ -15,21 +16,16 @@ _NativeDataType::_NativeDataType(
 	const uint8_t id,
 	const std::string& name,
 	const std::vector<std::pair<std::string, CodeValue>>& availableValues,
-	const std::string& defaultName,
 	CodeValue defaultValue) :
 	_id{ id },
 	_name{ name },
 	_integerType{ false },
 	_avByName{},
-	_avByValue{},
 	_defvalue{ defaultValue }
 {
 	for (const auto& aval : availableValues)
-	{
 		if (!aval.first.empty())
 			_avByName[aval.first] = aval.second;
-		_avByValue[aval.second] = defaultName;
-	}
 }
 
 const std::string& _NativeDataType::name() const { return _name; }
@@ -49,13 +45,13 @@ bool _NativeDataType::isValidIdentifier(const std::string& identifier) const
 
 bool _NativeDataType::isValidValue(CodeValue value) const
 {
-	return _avByValue.find(value) != _avByValue.end();
+	return _ConstantsByValue[value].type == this;
 }
 
 std::string _NativeDataType::getValueIdentifier(CodeValue value) const
 {
-	const auto& it = _avByValue.find(value);
-	return it != _avByValue.end() ? it->second : "";
+	const ValueEntry entry = _ConstantsByValue[value];
+	return entry.type == this ? *entry.name : "";
 }
 
 CodeValue _NativeDataType::getIdentifierValue(const std::string& identifier) const
@@ -72,8 +68,7 @@ bool _NativeDataType::operator!= (const _NativeDataType& dt) const { return _id
 std::map<std::string, _NativeDataType> _NativeDataType::_MappedTypes{};
 std::vector<_NativeDataType*> _NativeDataType::_TypesList{};
 
-std::map<std::string, _NativeDataType*> _NativeDataType::_MappedConstantByName{};
-std::map<CodeValue, _NativeDataType*> _NativeDataType::_MappedConstantByValue{};
+CodeTable<_NativeDataType::ValueEntry> _NativeDataType::_ConstantsByValue{};
 
 const _NativeDataType* _NativeDataType::registerType(const std::string& name)
 {
@@ -84,19 +79,8 @@ const _NativeDataType* _NativeDataType::registerType(const std::string& name)
 	auto result = _MappedTypes.emplace(std::pair<std::string, _NativeDataType>{ name, { id, name } });
 	if (result.second)
 	{
-		_NativeDataType* type = &result.first->second;
-		_TypesList.push_back(type);
-
-		for (auto& c : type->_avByName)
-		{
-			if (_MappedConstantByValue.find(c.second) == _MappedConstantByValue.end())
-			{
-				_MappedConstantByName[c.first] = type;
-				_MappedConstantByValue[c.second] = type;
-			}
-		}
-
-		return type;
+		_TypesList.push_back(&result.first->second);
+		return &result.first->second;
 	}
 	else return nullptr;
 }
@@ -106,11 +90,23 @@ const _NativeDataType* _NativeDataType::registerType(const std::string& name, co
 		return nullptr;
 
 	const uint8_t id = static_cast<uint8_t>(_MappedTypes.size());
-	auto result = _MappedTypes.emplace(std::pair<std::string, _NativeDataType>{ name, { id, name, availableValues, defaultName, defaultValue } });
+	auto result = _MappedTypes.emplace(std::pair<std::string, _NativeDataType>{ name, { id, name, availableValues, defaultValue } });
 	if (result.second)
 	{
-		_TypesList.push_back(&result.first->second);
-		return &result.first->second;
+		_NativeDataType* type = &result.first->second;
+		_TypesList.push_back(type);
+
+		/* Values without identifier are displayed with the default name */
+		const std::string& defaultIdentifier = type->_avByName.find(defaultName)->first;
+		for (const auto& aval : availableValues)
+		{
+			if (_ConstantsByValue[aval.second].type)
+				continue;
+			const std::string* identifier = aval.first.empty() ? &defaultIdentifier : &type->_avByName.find(aval.first)->first;
+			_ConstantsByValue.set(aval.second, { type, identifier });
+		}
+
+		return type;
 	}
 	else return nullptr;
 }
@@ -120,89 +116,144 @@ const _NativeDataType* _NativeDataType::getType(const std::string& name)
 {
 	return &_MappedTypes.find(name)->second;
 }
-const _NativeDataType* _NativeDataType::findTypeFromValue(CodeValue value)
-{
-	const auto& it = _MappedConstantByValue.find(value);
-	return it == _MappedConstantByValue.end() ? nullptr : it->second;
-}
-const _NativeDataType* _NativeDataType::findTypeFromValueName(const std::string& value)
+const _NativeDataType* _NativeDataType::findTypeFromValue(CodeValue value) { return _ConstantsByValue[value].type; }
+
+
+
+
+
+
+
+namespace
 {
-	const auto& it = _MappedConstantByName.find(value);
-	return it == _MappedConstantByName.end() ? nullptr : it->second;
+	enum class NativeTypeId : uint8_t
+	{
+		Integer,
+		State,
+		Team,
+		Spell,
+		Follower,
+		Building
+	};
+
+	struct ConstantInfo
+	{
+		NativeTypeId type;
+		CodeValue value;
+	};
+
+	/* Every named constant of every native type. Unnamed entries are valid values without identifier. */
+	constexpr perfect_hash::Entry<ConstantInfo> constants[] = {
+		{ "on", { NativeTypeId::State, InstructionToken::On } },
+		{ "off", { NativeTypeId::State, InstructionToken::Off } },
+
+		{ "Blue", { NativeTypeId::Team, CommandValueToken::Blue } },
+		{ "Red", { NativeTypeId::Team, CommandValueToken::Red } },
+		{ "Yellow", { NativeTypeId::Team, CommandValueToken::Yellow } },
+		{ "Green", { NativeTypeId::Team, CommandValueToken::Green } },
+
+		{ "", { NativeTypeId::Spell, ReadOnlyInternal::Burn } },
+		{ "Blast", { NativeTypeId::Spell, ReadOnlyInternal::Blast } },
+		{ "Lightning", { NativeTypeId::Spell, ReadOnlyInternal::LightningBolt } },
+		{ "", { NativeTypeId::Spell, ReadOnlyInternal::Whirlwind } },
+		{ "Swarm", { NativeTypeId::Spell, ReadOnlyInternal::InsectPlague } },
+		{ "Invisibility", { NativeTypeId::Spell, ReadOnlyInternal::Invisibility } },
+		{ "Hypnotism", { NativeTypeId::Spell, ReadOnlyInternal::Hypnotism } },
+		{ "Firestorm", { NativeTypeId::Spell, ReadOnlyInternal::Firestorm } },
+		{ "GhostArmy", { NativeTypeId::Spell, ReadOnlyInternal::GhostArmy } },
+		{ "Erosion", { NativeTypeId::Spell, ReadOnlyInternal::Erosion } },
+		{ "Swamp", { NativeTypeId::Spell, ReadOnlyInternal::Swamp } },
+		{ "LandBridge", { NativeTypeId::Spell, ReadOnlyInternal::LandBridge } },
+		{ "AngelOfDead", { NativeTypeId::Spell, ReadOnlyInternal::AngelOfDead } },
+		{ "Earthquake", { NativeTypeId::Spell, ReadOnlyInternal::Earthquake } },
+		{ "Flatten", { NativeTypeId::Spell, ReadOnlyInternal::Flatten } },
+		{ "Volcano", { NativeTypeId::Spell, ReadOnlyInternal::Volcano } },
+		{ "Armageddon", { NativeTypeId::Spell, ReadOnlyInternal::WrathOfGod } },
+		{ "Shield", { NativeTypeId::Spell, ReadOnlyInternal::Shield } },
+		{ "Convert", { NativeTypeId::Spell, ReadOnlyInternal::Convert } },
+		{ "Teleport", { NativeTypeId::Spell, ReadOnlyInternal::Teleport } },
+		{ "Bloodlust", { NativeTypeId::Spell, ReadOnlyInternal::Bloodlust } },
+		{ "UndefinedSpell", { NativeTypeId::Spell, ReadOnlyInternal::NoSpecificSpell } },
+
+		{ "Brave", { NativeTypeId::Follower, ReadOnlyInternal::Brave } },
+		{ "Warrior", { NativeTypeId::Follower, ReadOnlyInternal::Warrior } },
+		{ "Religious", { NativeTypeId::Follower, ReadOnlyInternal::Religious } },
+		{ "Spy", { NativeTypeId::Follower, ReadOnlyInternal::Spy } },
+		{ "Firewarrior", { NativeTypeId::Follower, ReadOnlyInternal::Firewarrior } },
+		{ "Shaman", { NativeTypeId::Follower, ReadOnlyInternal::Shaman } },
+		{ "UndefinedFollower", { NativeTypeId::Follower, ReadOnlyInternal::NoSpecificPerson } },
+
+		{ "SmallHut", { NativeTypeId::Building, ReadOnlyInternal::SmallHut } },
+		{ "MediumHut", { NativeTypeId::Building, ReadOnlyInternal::MediumHut } },
+		{ "LargeHut", { NativeTypeId::Building, ReadOnlyInternal::LargeHut } },
+		{ "DrumTower", { NativeTypeId::Building, ReadOnlyInternal::DrumTower } },
+		{ "Temple", { NativeTypeId::Building, ReadOnlyInternal::Temple } },
+		{ "SpyTrain", { NativeTypeId::Building, ReadOnlyInternal::SpyTrain } },
+		{ "WarriorTrain", { NativeTypeId::Building, ReadOnlyInternal::WarriorTrain } },
+		{ "FirewarriorTrain", { NativeTypeId::Building, ReadOnlyInternal::FirewarriorTrain } },
+		{ "", { NativeTypeId::Building, ReadOnlyInternal::Reconversion } },
+		{ "", { NativeTypeId::Building, ReadOnlyInternal::WallPiece } },
+		{ "", { NativeTypeId::Building, ReadOnlyInternal::Gate } },
+		{ "BoatHut", { NativeTypeId::Building, ReadOnlyInternal::BoatHut } },
+		{ "", { NativeTypeId::Building, ReadOnlyInternal::BoatHut2 } },
+		{ "AirshipHut", { NativeTypeId::Building, ReadOnlyInternal::AirshipHut } },
+		{ "", { NativeTypeId::Building, ReadOnlyInternal::AirshipHut2 } },
+		{ "UndefinedBuilding", { NativeTypeId::Building, ReadOnlyInternal::NoSpecificBuilding } }
+	};
+
+	constexpr perfect_hash::Table<ConstantInfo, sizeof(constants) / sizeof(*constants), 512> constants_by_name{ constants };
+
+	static_assert(constants_by_name.isValid(), "No perfect hash found for the constant names");
+
+	std::vector<std::pair<std::string, CodeValue>> constants_of(NativeTypeId type)
+	{
+		std::vector<std::pair<std::string, CodeValue>> values;
+		for (const auto& entry : constants)
+			if (entry.value.type == type)
+				values.emplace_back(entry.name, entry.value.value);
+		return values;
+	}
 }
 
+const _NativeDataType* const _NativeDataType::Integer{ _NativeDataType::registerType("Integer") };
+
+const _NativeDataType* const _NativeDataType::State{ _NativeDataType::registerType("State", constants_of(NativeTypeId::State), "off", InstructionToken::Off) };
 
+const _NativeDataType* const _NativeDataType::Team{ _NativeDataType::registerType("Team", constants_of(NativeTypeId::Team), "Blue", CommandValueToken::Blue) };
 
+const _NativeDataType* const _NativeDataType::Spell{ _NativeDataType::registerType("Spell", constants_of(NativeTypeId::Spell), "Blast", ReadOnlyInternal::Blast) };
 
+const _NativeDataType* const _NativeDataType::Follower{ _NativeDataType::registerType("Follower", constants_of(NativeTypeId::Follower), "Brave", ReadOnlyInternal::Brave) };
 
+const _NativeDataType* const _NativeDataType::Building{ _NativeDataType::registerType("Building", constants_of(NativeTypeId::Building), "SmallHut", ReadOnlyInternal::SmallHut) };
 
-const _NativeDataType* const _NativeDataType::Integer{ _NativeDataType::registerType("Integer") };
+static const _NativeDataType* native_type(NativeTypeId type)
+{
+	switch (type)
+	{
+		case NativeTypeId::Integer: return _NativeDataType::Integer;
+		case NativeTypeId::State: return _NativeDataType::State;
+		case NativeTypeId::Team: return _NativeDataType::Team;
+		case NativeTypeId::Spell: return _NativeDataType::Spell;
+		case NativeTypeId::Follower: return _NativeDataType::Follower;
+		case NativeTypeId::Building: return _NativeDataType::Building;
+	}
+	return nullptr;
+}
 
-const _NativeDataType* const _NativeDataType::State{ _NativeDataType::registerType("State", {
-	{ "on", InstructionToken::On },
-	{ "off", InstructionToken::Off }
-}, "off", InstructionToken::Off) };
-
-const _NativeDataType* const _NativeDataType::Team{ _NativeDataType::registerType("Team", {
-	{ "Blue", CommandValueToken::Blue },
-	{ "Red", CommandValueToken::Red },
-	{ "Yellow", CommandValueToken::Yellow },
-	{ "Green", CommandValueToken::Green }
-}, "Blue", CommandValueToken::Blue) };
-
-const _NativeDataType* const _NativeDataType::Spell{ _NativeDataType::registerType("Spell", {
-	{ "", ReadOnlyInternal::Burn },
-	{ "Blast", ReadOnlyInternal::Blast },
-	{ "Lightning", ReadOnlyInternal::LightningBolt },
-	{ "", ReadOnlyInternal::Whirlwind },
-	{ "Swarm", ReadOnlyInternal::InsectPlague },
-	{ "Invisibility", ReadOnlyInternal::Invisibility },
-	{ "Hypnotism", ReadOnlyInternal::Hypnotism },
-	{ "Firestorm", ReadOnlyInternal::Firestorm },
-	{ "GhostArmy", ReadOnlyInternal::GhostArmy },
-	{ "Erosion", ReadOnlyInternal::Erosion },
-	{ "Swamp", ReadOnlyInternal::Swamp },
-	{ "LandBridge", ReadOnlyInternal::LandBridge },
-	{ "AngelOfDead", ReadOnlyInternal::AngelOfDead },
-	{ "Earthquake", ReadOnlyInternal::Earthquake },
-	{ "Flatten", ReadOnlyInternal::Flatten },
-	{ "Volcano", ReadOnlyInternal::Volcano },
-	{ "Armageddon", ReadOnlyInternal::WrathOfGod },
-	{ "Shield", ReadOnlyInternal::Shield },
-	{ "Convert", ReadOnlyInternal::Convert },
-	{ "Teleport", ReadOnlyInternal::Teleport },
-	{ "Bloodlust", ReadOnlyInternal::Bloodlust },
-	{ "UndefinedSpell", ReadOnlyInternal::NoSpecificSpell }
-}, "Blast", ReadOnlyInternal::Blast) };
-
-const _NativeDataType* const _NativeDataType::Follower{ _NativeDataType::registerType("Follower", {
-	{ "Brave", ReadOnlyInternal::Brave },
-	{ "Warrior", ReadOnlyInternal::Warrior },
-	{ "Religious", ReadOnlyInternal::Religious },
-	{ "Spy", ReadOnlyInternal::Spy },
-	{ "Firewarrior", ReadOnlyInternal::Firewarrior },
-	{ "Shaman", ReadOnlyInternal::Shaman },
-	{ "UndefinedFollower", ReadOnlyInternal::NoSpecificPerson }
-}, "Brave", ReadOnlyInternal::Brave) };
-
-const _NativeDataType* const _NativeDataType::Building{ _NativeDataType::registerType("Building", {
-	{ "SmallHut", ReadOnlyInternal::SmallHut },
-	{ "MediumHut", ReadOnlyInternal::MediumHut },
-	{ "LargeHut", ReadOnlyInternal::LargeHut },
-	{ "DrumTower", ReadOnlyInternal::DrumTower },
-	{ "Temple", ReadOnlyInternal::Temple },
-	{ "SpyTrain", ReadOnlyInternal::SpyTrain },
-	{ "WarriorTrain", ReadOnlyInternal::WarriorTrain },
-	{ "FirewarriorTrain", ReadOnlyInternal::FirewarriorTrain },
-	{ "", ReadOnlyInternal::Reconversion },
-	{ "", ReadOnlyInternal::WallPiece },
-	{ "", ReadOnlyInternal::Gate },
-	{ "BoatHut", ReadOnlyInternal::BoatHut },
-	{ "", ReadOnlyInternal::BoatHut2 },
-	{ "AirshipHut", ReadOnlyInternal::AirshipHut },
-	{ "", ReadOnlyInternal::AirshipHut2 },
-	{ "UndefinedBuilding", ReadOnlyInternal::NoSpecificBuilding }
-}, "SmallHut", ReadOnlyInternal::SmallHut) };
+const _NativeDataType* _NativeDataType::findTypeFromValueName(const std::string& value)
+{
+	const ConstantInfo* info = constants_by_name.find(value);
+	return info ? native_type(info->type) : nullptr;
+}
+const _NativeDataType* _NativeDataType::findTypeFromValueName(const std::string& value, CodeValue& code)
+{
+	const ConstantInfo* info = constants_by_name.find(value);
+	if (!info)
+		return nullptr;
+	code = info->value;
+	return native_type(info->type);
+}
 
 
 
@@ -241,6 +292,7 @@ bool DataType::isValidType(const std::string& name) { return _NativeDataType::is
 DataType DataType::getType(const std::string& name) { return _NativeDataType::getType(name); }
 DataType DataType::findTypeFromValue(CodeValue value) { return _NativeDataType::findTypeFromValue(value); }
 DataType DataType::findTypeFromValueName(const std::string& value) { return _NativeDataType::findTypeFromValueName(value); }
+DataType DataType::findTypeFromValueName(const std::string& value, CodeValue& code) { return _NativeDataType::findTypeFromValueName(value, code); }
 
 DataType DataType::integer() { return { _NativeDataType::Integer }; }
 DataType DataType::state() { return { _NativeDataType::State }; }
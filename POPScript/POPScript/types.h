@@ -17,12 +17,11 @@ namespace
 
 		bool _integerType;
 		std::map<std::string, CodeValue> _avByName;
-		std::map<CodeValue, std::string> _avByValue;
 
 		CodeValue _defvalue;
 
 		_NativeDataType(const uint8_t id, const std::string& name);
-		_NativeDataType(const uint8_t id, const std::string& name, const std::vector<std::pair<std::string, CodeValue>>& availableValues, const std::string& defaultName, CodeValue defaultValue);
+		_NativeDataType(const uint8_t id, const std::string& name, const std::vector<std::pair<std::string, CodeValue>>& availableValues, CodeValue defaultValue);
 
 	public:
 		const std::string& name() const;
@@ -40,11 +39,16 @@ namespace
 
 
 	private:
+		struct ValueEntry
+		{
+			const _NativeDataType* type;
+			const std::string* name;
+		};
+
 		static std::map<std::string, _NativeDataType> _MappedTypes;
 		static std::vector<_NativeDataType*> _TypesList;
 
-		static std::map<std::string, _NativeDataType*> _MappedConstantByName;
-		static std::map<CodeValue, _NativeDataType*> _MappedConstantByValue;
+		static CodeTable<ValueEntry> _ConstantsByValue;
 
 		static const _NativeDataType* registerType(const std::string& name);
 		static const _NativeDataType* registerType(const std::string& name, const std::vector<std::pair<std::string, CodeValue>>& availableValues, const std::string& defaultName, CodeValue defaultValue);
@@ -54,6 +58,7 @@ namespace
 		static const _NativeDataType* getType(const std::string& name);
 		static const _NativeDataType* findTypeFromValue(CodeValue value);
 		static const _NativeDataType* findTypeFromValueName(const std::string& value);
+		static const _NativeDataType* findTypeFromValueName(const std::string& value, CodeValue& code);
 
 		static const _NativeDataType* const Integer;
 		static const _NativeDataType* const State;
@@ -97,6 +102,7 @@ public:
 	static DataType getType(const std::string& name);
 	static DataType findTypeFromValue(CodeValue value);
 	static DataType findTypeFromValueName(const std::string& value);
+	static DataType findTypeFromValueName(const std::string& value, CodeValue& code);
 
 	static DataType integer();
 	static DataType state();
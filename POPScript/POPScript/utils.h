@@ -90,6 +90,12 @@ void wide_memset(void* const _Dst, const _Ty value, const uintptr_t size)
 		*(reinterpret_cast<_Ty*>(_Dst) + i) = value;
 }
 
+/* Mixes value into a running hash */
+inline size_t hash_combine(size_t seed, size_t value)
+{
+	return seed ^ (value + static_cast<size_t>(0x9e3779b97f4a7c15ULL) + (seed << 6) + (seed >> 2));
+}
+
 template<typename _Ty>
 std::vector<_Ty> slice(const std::vector<_Ty>& vec, size_t from, size_t to)
 {
@@ -189,16 +195,36 @@ public:
 
 /* Cloneable Allocator */
 
+template<class _Base>
+class CloneableAllocator;
+
 class Cloneable
 {
+private:
+	/* Number of CloneableAllocators sharing this object. Not atomic: a tree belongs to one thread. */
+	mutable size_t _references;
+
 public:
+	Cloneable() : _references{ 0 } {}
+	Cloneable(const Cloneable&) : _references{ 0 } {}
 	virtual ~Cloneable() {};
 
+	Cloneable& operator= (const Cloneable&) { return *this; }
+
 	virtual void* clone() const = 0;
+
+	template<class _Base>
+	friend class CloneableAllocator;
 };
 
 
-#define __clone(_Value) reinterpret_cast<_Base*>(reinterpret_cast<const Cloneable&>(_Value).clone())
+/*
+ * Values held by CloneableAllocators are shared, not cloned: copying an allocator, or building one from an object
+ * another allocator already holds, only takes a reference. Objects not held by any allocator (locals, statics) are
+ * cloned. Held values are only reachable as const; mutate() clones a shared value first and lends the result to a
+ * callback, so no mutable reference outlives the call and sharing is never observable.
+ */
+#define __clone(_Value) reinterpret_cast<_Base*>(static_cast<const Cloneable&>(_Value).clone())
 template<class _Base>
 class CloneableAllocator
 {
@@ -207,11 +233,38 @@ class CloneableAllocator
 private:
 	_Base* _data;
 
+	static inline size_t& references(const _Base* data) { return static_cast<const Cloneable*>(data)->_references; }
+
+	static _Base* share(const _Base& base)
+	{
+		_Base* data = references(&base) ? const_cast<_Base*>(&base) : __clone(base);
+		references(data)++;
+		return data;
+	}
+
+	static void release(_Base* data)
+	{
+		if (data && --references(data) == 0)
+			delete data;
+	}
+
+	_Base* detach()
+	{
+		if (_data && references(_data) > 1)
+		{
+			_Base* data = __clone(*_data);
+			references(data)++;
+			release(_data);
+			_data = data;
+		}
+		return _data;
+	}
+
 public:
 	CloneableAllocator() : _data{ nullptr } {}
-	CloneableAllocator(const _Base& base) : _data{ __clone(base) } {}
-	CloneableAllocator(const _Base* base) : _data{ base ? (__clone(base)) : nullptr } {}
-	CloneableAllocator(const CloneableAllocator& a) : _data{ !a._data ? nullptr : __clone(a._data) } {}
+	CloneableAllocator(const _Base& base) : _data{ share(base) } {}
+	CloneableAllocator(const _Base* base) : _data{ base ? share(*base) : nullptr } {}
+	CloneableAllocator(const CloneableAllocator& a) : _data{ !a._data ? nullptr : share(*a._data) } {}
 	CloneableAllocator(CloneableAllocator&& a) noexcept :
 		_data{ std::move(a._data) }
 	{
@@ -219,77 +272,77 @@ public:
 	}
 	~CloneableAllocator()
 	{
-		if (_data)
-			delete _data;
+		release(_data);
 	}
 
 	CloneableAllocator& operator= (const _Base& base)
 	{
 		auto old = _data;
-		_data = __clone(base);
-		if(old)
-			delete old;
+		_data = share(base);
+		release(old);
 		return *this;
 	}
 	CloneableAllocator& operator= (decltype(nullptr))
 	{
-		if (_data)
-			delete _data;
+		release(_data);
 		_data = nullptr;
 		return *this;
 	}
 	CloneableAllocator& operator= (const CloneableAllocator& a)
 	{
 		auto old = _data;
-		_data = !a._data ? nullptr : __clone(a._data);
-		if (old)
-			delete old;
+		_data = !a._data ? nullptr : share(*a._data);
+		release(old);
 		return *this;
 	}
 	CloneableAllocator& operator= (CloneableAllocator&& a) noexcept
 	{
 		auto old = _data;
 		_data = std::move(a._data);
-		if (old)
-			delete old;
+		release(old);
 		a._data = nullptr;
 		return *this;
 	}
 
 	bool operator== (const CloneableAllocator& a) const
 	{
-		if (!_data)
-			return !a._data;
-		return a._data && _data->operator==(*a._data);
+		if (_data == a._data)
+			return true;
+		return _data && a._data && _data->operator==(*a._data);
 	}
 	bool operator!= (const CloneableAllocator& a) const
 	{
-		if (!_data)
-			return a._data;
-		return !a._data || _data->operator!=(*a._data);
+		if (_data == a._data)
+			return false;
+		return !_data || !a._data || _data->operator!=(*a._data);
 	}
 
 	bool operator== (const _Base& b) const
 	{
-		if (!_data)
-			return false;
-		return _data->operator==(b);
+		if (_data == &b)
+			return true;
+		return _data && _data->operator==(b);
 	}
 	bool operator!= (const _Base& b) const
 	{
-		if (!_data)
-			return true;
-		return _data->operator!=(b);
+		if (_data == &b)
+			return false;
+		return !_data || _data->operator!=(b);
 	}
 
-	operator _Base& () { return *_data; }
 	operator const _Base&() const { return *_data; }
 
 	operator bool() const { return _data; }
 	bool operator! () const { return !_data; }
 
-	inline _Base* operator-> () { return _data; }
+	/* True if no other allocator shares the value */
+	bool unique() const { return _data && references(_data) == 1; }
+
 	inline const _Base* operator-> () const { return _data; }
+
+	/* Calls fn with the value, unshared first. The reference must not be kept past the call. */
+	template<typename _Fn>
+	void mutate(_Fn&& fn) { fn(*detach()); }
 };
 #undef __clone
 
@@ -335,21 +388,20 @@ public:
 	inline const _Base& front() const { return _data.front(); }
 	inline const _Base& back() const { return _data.back(); }
 
-	inline _Base& operator[] (const size_t index) { return _data[index]; }
 	inline const _Base& operator[] (const size_t index) const { return _data[index]; }
 
 	inline operator bool() const { return !_data.empty(); }
 
 	inline bool operator! () { return _data.empty(); }
 
-	bool operator== (const CloneableVector<_Base>& v) { return _data == v._data; }
+	bool operator== (const CloneableVector<_Base>& v) const { return _data == v._data; }
 
-	bool operator!= (const CloneableVector<_Base>& v) { return _data != v._data; }
+	bool operator!= (const CloneableVector<_Base>& v) const { return _data != v._data; }
 
 	void for_each(std::function<void(_Base&)> action)
 	{
 		for (CloneableAllocator<_Base>& value : _data)
-			action(value);
+			value.mutate(action);
 	}
 
 	void for_each(std::function<void(const _Base&)> action) const
@@ -362,7 +414,7 @@ public:
 	{
 		size_t idx = 0;
 		for (CloneableAllocator<_Base>& value : _data)
-			action(value, idx++);
+			value.mutate([&action, &idx](_Base& base) { action(base, idx++); });
 	}
 
 	void for_each(std::function<void(const _Base&, size_t)> action) const